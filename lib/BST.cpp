@@ -1,16 +1,243 @@
-
+#include <algorithm>
+#include <atomic>
+#include <compare>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BST_HAS_MMAP 1
+#endif
 
 struct inorder_tag {};
 struct preorder_tag {};
 struct postorder_tag {};
 
+struct static_access {};
+struct splay_access {};
+
+struct unique_keys {};
+struct multi_keys {};
+
+struct tree_statistics {
+  static constexpr size_t depth_buckets = 64;
+
+  size_t size = 0;
+  size_t height = 0;
+  size_t depth_histogram[depth_buckets] = {};
+  double average_path_length = 0;
+  size_t bytes = 0;
+
+  size_t comparisons = 0;
+  size_t nodes_visited = 0;
+  size_t allocations = 0;
+  size_t deallocations = 0;
+  size_t parent_climbs = 0;
+};
+
+struct no_stats {
+  struct climb_counter {
+    void on_climb() const {}
+  };
+
+  void on_compare() {}
+  void on_visit() {}
+  void on_allocate(size_t = 1) {}
+  void on_deallocate() {}
+  climb_counter climbs() { return {}; }
+  void report(tree_statistics&) const {}
+};
+
+struct counting_stats {
+  std::atomic<size_t> comparisons = 0;
+  std::atomic<size_t> nodes_visited = 0;
+  std::atomic<size_t> allocations = 0;
+  std::atomic<size_t> deallocations = 0;
+  std::atomic<size_t> parent_climbs = 0;
+
+  struct climb_counter {
+    counting_stats* stats = nullptr;
+
+    void on_climb() const {
+      if (stats != nullptr) {
+        stats->parent_climbs.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  void on_compare() { comparisons.fetch_add(1, std::memory_order_relaxed); }
+  void on_visit() { nodes_visited.fetch_add(1, std::memory_order_relaxed); }
+  void on_allocate(size_t count = 1) {
+    allocations.fetch_add(count, std::memory_order_relaxed);
+  }
+  void on_deallocate() {
+    deallocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  climb_counter climbs() { return {this}; }
+
+  void report(tree_statistics& stats) const {
+    stats.comparisons = comparisons.load(std::memory_order_relaxed);
+    stats.nodes_visited = nodes_visited.load(std::memory_order_relaxed);
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.deallocations = deallocations.load(std::memory_order_relaxed);
+    stats.parent_climbs = parent_climbs.load(std::memory_order_relaxed);
+  }
+};
+
+struct bst_file_header {
+  static constexpr std::uint32_t signature = 0x31545342;
+  static constexpr std::uint32_t current_version = 1;
+
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t value_size;
+  std::uint32_t value_align;
+  std::uint64_t count;
+  std::uint64_t checksum;
+
+  template <typename T>
+  static bst_file_header make(std::uint64_t count, std::uint64_t checksum) {
+    return {signature, current_version, sizeof(T), alignof(T), count,
+            checksum};
+  }
+
+  static constexpr std::uint64_t hash_seed = 14695981039346656037ULL;
+
+  static std::uint64_t hash(std::uint64_t seed, const void* data,
+                            std::uint64_t bytes) {
+    const unsigned char* it = static_cast<const unsigned char*>(data);
+    for (std::uint64_t i = 0; i < bytes; ++i) {
+      seed = (seed ^ it[i]) * 1099511628211ULL;
+    }
+    return seed;
+  }
+
+  static std::uint64_t hash(const void* data, std::uint64_t bytes) {
+    return hash(hash_seed, data, bytes);
+  }
+
+  template <typename T>
+  void check() const {
+    if (magic != signature) {
+      throw std::runtime_error("bst: bad file signature");
+    }
+    if (version != current_version) {
+      throw std::runtime_error("bst: unsupported file version");
+    }
+    if (value_size != sizeof(T) || value_align != alignof(T)) {
+      throw std::runtime_error("bst: stored value type does not match");
+    }
+  }
+};
+
+template <typename T>
+class bst_generator : public std::ranges::view_interface<bst_generator<T>> {
+ public:
+  struct promise_type {
+    const T* current = nullptr;
+
+    bst_generator get_return_object() {
+      return bst_generator(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(const T& value) noexcept {
+      current = &value;
+      return {};
+    }
+    void return_void() {}
+    void unhandled_exception() { throw; }
+  };
+
+  class iterator {
+    friend bst_generator;
+
+   public:
+    using value_type = T;
+    using pointer = const T*;
+    using reference = const T&;
+    using difference_type = std::ptrdiff_t;
+
+   private:
+    std::coroutine_handle<promise_type> handle;
+    iterator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+   public:
+    iterator() : handle(nullptr) {}
+
+    reference operator*() const { return *handle.promise().current; }
+    pointer operator->() const { return handle.promise().current; }
+
+    iterator& operator++() {
+      handle.resume();
+      return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    bool operator==(std::default_sentinel_t) const {
+      return !handle || handle.done();
+    }
+  };
+
+ private:
+  std::coroutine_handle<promise_type> handle;
+  bst_generator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+ public:
+  bst_generator() : handle(nullptr) {}
+  bst_generator(bst_generator&& other) noexcept
+      : handle(std::exchange(other.handle, nullptr)) {}
+  bst_generator& operator=(bst_generator&& other) noexcept {
+    std::swap(handle, other.handle);
+    return *this;
+  }
+  ~bst_generator() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  iterator begin() {
+    if (handle) {
+      handle.resume();
+    }
+    return handle;
+  }
+
+  std::default_sentinel_t end() const { return {}; }
+};
+
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, Value>>,
+          typename Stats = no_stats>
+class BinarySearchTreeMap;
+
 template <typename T, typename Compare = std::less<T>,
-          typename Allocator = std::allocator<T>>
+          typename Allocator = std::allocator<T>, typename Stats = no_stats,
+          typename Access = static_access, typename Uniqueness = unique_keys>
 class BinarySearchTree {
+  template <typename, typename, typename, typename, typename>
+  friend class BinarySearchTreeMap;
+
  private:
   class Node;
 
@@ -24,6 +251,9 @@ class BinarySearchTree {
   struct Node : public BaseNode {
     T key;
     Node(const T& key) : key(key) {}
+    Node(T&& key) : key(std::move(key)) {}
+    template <typename... Args>
+    Node(std::in_place_t, Args&&... args) : key(std::forward<Args>(args)...) {}
   };
 
   template <typename traversal_type = inorder_tag>
@@ -31,15 +261,21 @@ class BinarySearchTree {
     friend BinarySearchTree;
 
    public:
-    using value_type = const T;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
     using key_type = const T;
+    using pointer = const T*;
+    using reference = const T&;
     using pointer_type = const T*;
     using reference_type = const T&;
-    using difference_type = size_t;
+    using difference_type = std::ptrdiff_t;
 
    private:
     const BaseNode* ptr;
-    base_iterator(const BaseNode* ptr) : ptr(ptr) {}
+    [[no_unique_address]] typename Stats::climb_counter climbs;
+
+    base_iterator(const BaseNode* ptr, typename Stats::climb_counter climbs)
+        : ptr(ptr), climbs(climbs) {}
 
     bool is_base_node(const BaseNode* node) {
       return (node == node->parent ||
@@ -55,6 +291,7 @@ class BinarySearchTree {
       } else {
         node_type* par = ptr->parent;
         while (!is_base_node(par) && (par->right == ptr)) {
+          climbs.on_climb();
           ptr = par;
           par = par->parent;
         }
@@ -71,6 +308,7 @@ class BinarySearchTree {
       } else {
         node_type* par = ptr->parent;
         while (!(par->left == ptr && par->right != nullptr)) {
+          climbs.on_climb();
           ptr = par;
           par = par->parent;
         }
@@ -108,6 +346,7 @@ class BinarySearchTree {
       } else {
         node_type* par = ptr->parent;
         while (!is_base_node(par) && (par->left == ptr)) {
+          climbs.on_climb();
           ptr = par;
           par = par->parent;
         }
@@ -150,6 +389,7 @@ class BinarySearchTree {
         node_type* par = ptr->parent;
         while (!(par->right == ptr && par->left != nullptr) &&
                !is_base_node(par)) {
+          climbs.on_climb();
           ptr = par;
           par = par->parent;
         }
@@ -159,11 +399,13 @@ class BinarySearchTree {
     }
 
    public:
+    base_iterator() : ptr(nullptr), climbs() {}
     base_iterator(const base_iterator&) = default;
     base_iterator& operator=(const base_iterator&) = default;
 
-    bool operator==(const base_iterator& other) const = default;
-    bool operator!=(const base_iterator& other) const = default;
+    bool operator==(const base_iterator& other) const {
+      return ptr == other.ptr;
+    }
 
     reference_type operator*() const {
       return (static_cast<const Node*>(ptr))->key;
@@ -223,456 +465,2012 @@ class BinarySearchTree {
   size_type size_;
   Compare comp;
   std::allocator_traits<Allocator>::template rebind_alloc<Node> alloc;
+  [[no_unique_address]] mutable Stats stats_;
 
-  node_type* begin_(inorder_tag) const { return base_node_.right; }
-
-  node_type* begin_(preorder_tag) const { return base_node_.left; }
+  struct NoCache {};
+  [[no_unique_address]] mutable std::conditional_t<
+      std::is_same_v<Access, splay_access>, std::atomic<node_type*>, NoCache>
+      postorder_begin_;
 
-  node_type* begin_(postorder_tag) const { return base_node_.parent; }
+  static constexpr bool multi_ = std::is_same_v<Uniqueness, multi_keys>;
+  static constexpr bool splaying_ = std::is_same_v<Access, splay_access>;
 
- public:
-  BinarySearchTree(Compare comp = Compare(), Allocator alloc = Allocator())
-      : base_node_(), size_(0), comp(comp), alloc(alloc) {
-    base_node_.parent = static_cast<Node*>(&base_node_);
-    base_node_.right = static_cast<Node*>(&base_node_);
+  template <typename Lhs, typename Rhs>
+  bool less_(const Lhs& lhs, const Rhs& rhs) const {
+    stats_.on_compare();
+    return comp(lhs, rhs);
   }
 
-  template <typename It>
-  BinarySearchTree(It it1, It it2, Compare comp = Compare(),
-                   Allocator alloc = Allocator())
-      : base_node_(), size_(0), comp(comp), alloc(alloc) {
-    base_node_.parent = static_cast<Node*>(&base_node_);
-    base_node_.right = static_cast<Node*>(&base_node_);
-    insert(it1, it2);
+  auto counted_less_() const {
+    return [this](const_reference lhs, const_reference rhs) {
+      return less_(lhs, rhs);
+    };
   }
 
-  BinarySearchTree(const std::initializer_list<value_type>& il,
-                   Compare comp = Compare(), Allocator alloc = Allocator())
-      : base_node_(), size_(0), comp(comp), alloc(alloc) {
-    base_node_.parent = static_cast<Node*>(&base_node_);
-    base_node_.right = static_cast<Node*>(&base_node_);
-    insert(il);
-  }
+  node_type* begin_(inorder_tag) const { return base_node_.right; }
 
-  BinarySearchTree(const BinarySearchTree& other)
-      : base_node_(), size_(0), comp(other.comp), alloc(other.alloc) {
-    base_node_.parent = static_cast<Node*>(&base_node_);
-    base_node_.right = static_cast<Node*>(&base_node_);
-    insert(other.begin<preorder_tag>(), other.end<preorder_tag>());
+  node_type* begin_(preorder_tag) const {
+    return base_node_.left != nullptr ? base_node_.left : base_node_.right;
   }
 
-  BinarySearchTree& operator=(const BinarySearchTree& other) {
-    if (*this == other) {
-      return *this;
-    }
-    clear();
-    comp = other.comp;
-    alloc = other.alloc;
-    for (auto it = other.begin<preorder_tag>(); it != other.end<preorder_tag>();
-         ++it) {
-      insert(*it);
+  node_type* begin_(postorder_tag) const {
+    if constexpr (splaying_) {
+      if (base_node_.left != nullptr) {
+        node_type* node = postorder_begin_.load(std::memory_order_relaxed);
+        if (node == nullptr) {
+          node = first_postorder_(base_node_.left);
+          postorder_begin_.store(node, std::memory_order_relaxed);
+        }
+        return node;
+      }
     }
-    return *this;
+    return base_node_.parent;
   }
 
-  BinarySearchTree& operator=(std::initializer_list<value_type> il) {
-    clear();
-    comp = Compare();
-    alloc = Allocator();
-    insert(il);
-    return *this;
-  }
+  static constexpr size_type parallel_grain_ = 1 << 12;
 
-  ~BinarySearchTree() { clear(); }
+  static auto synth_three_way_(const_reference lhs, const_reference rhs) {
+    if constexpr (std::three_way_comparable<T>) {
+      return lhs <=> rhs;
+    } else {
+      if (lhs < rhs) {
+        return std::weak_ordering::less;
+      }
+      if (rhs < lhs) {
+        return std::weak_ordering::greater;
+      }
+      return std::weak_ordering::equivalent;
+    }
+  }
 
-  template <typename traversal_type = inorder_tag>
-  iterator<traversal_type> begin() {
-    return const_iterator<traversal_type>{begin_(traversal_type{})};
+  static node_type* leftmost_(node_type* node) {
+    while (node->left != nullptr) {
+      node = node->left;
+    }
+    return node;
   }
 
-  template <typename traversal_type = inorder_tag>
-  iterator<traversal_type> end() {
-    return const_iterator<traversal_type>{static_cast<Node*>(&base_node_)};
+  static node_type* first_postorder_(node_type* node) {
+    while (!(node->left == nullptr && node->right == nullptr)) {
+      if (node->left != nullptr) {
+        node = node->left;
+      } else {
+        node = node->right;
+      }
+    }
+    return node;
   }
 
-  template <typename traversal_type = inorder_tag>
-  const_iterator<traversal_type> begin() const {
-    return const_iterator<traversal_type>{begin_(traversal_type{})};
+  static node_type* subtree_begin_(node_type* root, inorder_tag) {
+    return leftmost_(root);
   }
 
-  template <typename traversal_type = inorder_tag>
-  const_iterator<traversal_type> end() const {
-    return const_iterator<traversal_type>{
-        static_cast<const Node*>(&base_node_)};
+  static node_type* subtree_begin_(node_type* root, preorder_tag) {
+    return root;
   }
 
-  template <typename traversal_type = inorder_tag>
-  const_iterator<traversal_type> cbegin() const {
-    return const_iterator<traversal_type>{begin_(traversal_type{})};
+  static node_type* subtree_begin_(node_type* root, postorder_tag) {
+    return first_postorder_(root);
   }
 
-  template <typename traversal_type = inorder_tag>
-  const_iterator<traversal_type> cend() const {
-    return const_iterator<traversal_type>{
-        static_cast<const Node*>(&base_node_)};
+  static node_type* subtree_next_(node_type* node, node_type* root,
+                                  inorder_tag) {
+    if (node->right != nullptr) {
+      return leftmost_(node->right);
+    }
+    while (node != root && node->parent->right == node) {
+      node = node->parent;
+    }
+    return node == root ? nullptr : node->parent;
   }
 
-  template <typename traversal_type = inorder_tag>
-  reverse_iterator<traversal_type> rbegin() {
-    return std::reverse_iterator(static_cast<Node*>(&base_node_));
+  static node_type* subtree_next_(node_type* node, node_type* root,
+                                  preorder_tag) {
+    if (node->left != nullptr) {
+      return node->left;
+    }
+    if (node->right != nullptr) {
+      return node->right;
+    }
+    while (node != root && (node->parent->right == node ||
+                            node->parent->right == nullptr)) {
+      node = node->parent;
+    }
+    return node == root ? nullptr : node->parent->right;
   }
 
-  template <typename traversal_type = inorder_tag>
-  reverse_iterator<traversal_type> rend() {
-    return std::reverse_iterator(begin_(traversal_type{}));
+  static node_type* subtree_next_(node_type* node, node_type* root,
+                                  postorder_tag) {
+    if (node == root) {
+      return nullptr;
+    }
+    node_type* par = node->parent;
+    if (par->left == node && par->right != nullptr) {
+      return first_postorder_(par->right);
+    }
+    return par;
   }
 
-  template <typename traversal_type = inorder_tag>
-  const_reverse_iterator<traversal_type> rbegin() const {
-    return std::reverse_iterator(static_cast<const Node*>(&base_node_));
+  static size_type parallel_depth_(size_type count) {
+    size_type threads = std::thread::hardware_concurrency();
+    size_type depth = 0;
+    while ((size_type{1} << depth) < 4 * threads &&
+           (count >> depth) > parallel_grain_) {
+      ++depth;
+    }
+    return depth;
   }
 
-  template <typename traversal_type = inorder_tag>
-  const_reverse_iterator<traversal_type> rend() const {
-    return std::reverse_iterator(begin_(traversal_type{}));
+  using ValueAlloc =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+  using ValueAllocTraits = std::allocator_traits<ValueAlloc>;
+
+  struct Buffer {
+    ValueAlloc alloc;
+    T* data;
+    size_type size;
+    size_type constructed;
+    size_type capacity;
+
+    template <typename It>
+    Buffer(It first, It last, const ValueAlloc& alloc)
+        : alloc(alloc), data(nullptr), size(0), constructed(0), capacity(0) {
+      try {
+        if constexpr (std::forward_iterator<It>) {
+          reserve_(std::distance(first, last));
+        }
+        for (; first != last; ++first) {
+          if (constructed == capacity) {
+            reserve_(capacity == 0 ? 16 : 2 * capacity);
+          }
+          ValueAllocTraits::construct(this->alloc, data + constructed, *first);
+          ++constructed;
+        }
+      } catch (...) {
+        release_();
+        throw;
+      }
+      size = constructed;
+    }
+
+    Buffer(const ValueAlloc& alloc)
+        : alloc(alloc), data(nullptr), size(0), constructed(0), capacity(0) {}
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    ~Buffer() { release_(); }
+
+    void reserve_(size_type grown) {
+      if (grown <= capacity) {
+        return;
+      }
+      T* moved = ValueAllocTraits::allocate(alloc, grown);
+      size_type count = 0;
+      try {
+        for (; count < constructed; ++count) {
+          ValueAllocTraits::construct(alloc, moved + count,
+                                      std::move_if_noexcept(data[count]));
+        }
+      } catch (...) {
+        for (size_type i = 0; i < count; ++i) {
+          ValueAllocTraits::destroy(alloc, moved + i);
+        }
+        ValueAllocTraits::deallocate(alloc, moved, grown);
+        throw;
+      }
+      size_type kept = constructed;
+      release_();
+      data = moved;
+      constructed = kept;
+      capacity = grown;
+    }
+
+    void release_() {
+      for (size_type i = 0; i < constructed; ++i) {
+        ValueAllocTraits::destroy(alloc, data + i);
+      }
+      if (data != nullptr) {
+        ValueAllocTraits::deallocate(alloc, data, capacity);
+      }
+      data = nullptr;
+      constructed = 0;
+      capacity = 0;
+    }
+  };
+
+  static void parallel_sort_(T* data, size_type count, const Compare& comp,
+                             size_type depth) {
+    if (depth == 0) {
+      std::stable_sort(data, data + count, comp);
+      return;
+    }
+    size_type mid = count / 2;
+    std::future<void> left_task =
+        std::async(std::launch::async, [data, mid, &comp, depth]() {
+          parallel_sort_(data, mid, comp, depth - 1);
+        });
+    parallel_sort_(data + mid, count - mid, comp, depth - 1);
+    left_task.get();
+    std::inplace_merge(data, data + mid, data + count, comp);
   }
 
-  template <typename traversal_type = inorder_tag>
-  const_reverse_iterator<traversal_type> crbegin() const {
-    return std::reverse_iterator(static_cast<const Node*>(&base_node_));
+  void sort_unique_(Buffer& buffer, bool keep_equal = multi_) const {
+    parallel_sort_(buffer.data, buffer.size, comp,
+                   parallel_depth_(buffer.size));
+    if (keep_equal) {
+      return;
+    }
+    T* last = std::unique(buffer.data, buffer.data + buffer.size,
+                          [this](const_reference lhs, const_reference rhs) {
+                            return !comp(lhs, rhs) && !comp(rhs, lhs);
+                          });
+    buffer.size = last - buffer.data;
   }
 
-  template <typename traversal_type = inorder_tag>
-  const_reverse_iterator<traversal_type> crend() const {
-    return std::reverse_iterator(begin_(traversal_type{}));
+  static size_type build_depth_(size_type count) {
+    if constexpr (AllocTraits::is_always_equal::value) {
+      return parallel_depth_(count);
+    }
+    return 0;
   }
 
-  void swap(BinarySearchTree& other) {
-    if (*this == other) {
-      return;
+  template <typename NodeAlloc>
+  static node_type* build_(T* data, size_type count, node_type* parent,
+                           NodeAlloc alloc, size_type depth) {
+    if (count == 0) {
+      return nullptr;
     }
-    if (base_node_.left != nullptr) {
-      base_node_.left->parent = static_cast<Node*>(&(other.base_node_));
+    size_type mid = count / 2;
+    node_type* node = alloc.allocate(1);
+    try {
+      AllocTraits::construct(alloc, node, std::move(data[mid]));
+    } catch (...) {
+      alloc.deallocate(node, 1);
+      throw;
     }
-    if (other.base_node_.left != nullptr) {
-      other.base_node_.left->parent = static_cast<Node*>(&base_node_);
+    node->parent = parent;
+    auto release = [&alloc](node_type* built) {
+      AllocTraits::destroy(alloc, built);
+      alloc.deallocate(built, 1);
+    };
+    if (depth == 0) {
+      try {
+        node->left = build_(data, mid, node, alloc, 0);
+        node->right = build_(data + mid + 1, count - mid - 1, node, alloc, 0);
+      } catch (...) {
+        destroy_subtree_(node, release);
+        throw;
+      }
+      return node;
     }
-    std::swap(base_node_, other.base_node_);
-    std::swap(size_, other.size_);
-    std::swap(comp, other.comp);
-    std::swap(alloc, other.alloc);
+    std::future<node_type*> left_task;
+    try {
+      left_task =
+          std::async(std::launch::async, [data, mid, node, alloc, depth]() {
+            return build_(data, mid, node, alloc, depth - 1);
+          });
+      node->right =
+          build_(data + mid + 1, count - mid - 1, node, alloc, depth - 1);
+      node->left = left_task.get();
+    } catch (...) {
+      if (left_task.valid()) {
+        try {
+          node->left = left_task.get();
+        } catch (...) {
+        }
+      }
+      destroy_subtree_(node, release);
+      throw;
+    }
+    return node;
+  }
+
+  void refresh_ends_() {
     if (base_node_.left == nullptr) {
       base_node_.right = static_cast<Node*>(&base_node_);
       base_node_.parent = static_cast<Node*>(&base_node_);
+      return;
     }
-    if (other.base_node_.left == nullptr) {
-      other.base_node_.right = static_cast<Node*>(&other.base_node_);
-      other.base_node_.parent = static_cast<Node*>(&other.base_node_);
+    base_node_.right = leftmost_(base_node_.left);
+    if constexpr (splaying_) {
+      postorder_begin_.store(nullptr, std::memory_order_relaxed);
+    } else {
+      base_node_.parent = first_postorder_(base_node_.left);
     }
   }
 
-  size_type size() const { return size_; }
-
-  size_type max_size() const { return std::numeric_limits<size_type>::max(); }
-
-  bool empty() const { return begin() == end(); }
-
-  key_compare key_comp() const { return comp; }
+  void attach_root_(node_type* root, size_type count) {
+    size_ = count;
+    base_node_.left = root;
+    if (root != nullptr) {
+      root->parent = static_cast<Node*>(&base_node_);
+    }
+    refresh_ends_();
+  }
 
-  value_compare value_comp() const { return comp; }
+  void replace_child_(node_type* node, node_type* child) {
+    node_type* par = node->parent;
+    if (base_node_.left == node) {
+      base_node_.left = child;
+    } else if (par->left == node) {
+      par->left = child;
+    } else {
+      par->right = child;
+    }
+    if (child != nullptr) {
+      child->parent = par;
+    }
+  }
 
-  template <typename traversal_type = inorder_tag>
-  std::pair<iterator<traversal_type>, bool> insert(const_reference value) {
-    iterator<traversal_type> it = find<traversal_type>(value);
-    if (it != end<traversal_type>()) {
-      return std::make_pair(it, false);
+  void unlink_(node_type* node) {
+    node_type* replacement;
+    if (node->left == nullptr) {
+      replacement = node->right;
+    } else if (node->right == nullptr) {
+      replacement = node->left;
+    } else {
+      replacement = leftmost_(node->right);
+      if (replacement != node->right) {
+        replace_child_(replacement, replacement->right);
+        replacement->right = node->right;
+        replacement->right->parent = replacement;
+      }
+      replacement->left = node->left;
+      replacement->left->parent = replacement;
     }
-    ++size_;
-    node_type* leaf = alloc.allocate(1);
-    AllocTraits::construct(alloc, leaf, value);
-    if (base_node_.left == nullptr) {
-      base_node_.left = leaf;
-      base_node_.right = leaf;
-      base_node_.parent = leaf;
-      leaf->parent = static_cast<Node*>(&base_node_);
-      return std::make_pair(iterator<traversal_type>{leaf}, true);
+    replace_child_(node, replacement);
+  }
+
+  void rotate_up_(node_type* node) {
+    node_type* par = node->parent;
+    if (par->left == node) {
+      par->left = node->right;
+      if (node->right != nullptr) {
+        node->right->parent = par;
+      }
+      node->right = par;
+    } else {
+      par->right = node->left;
+      if (node->left != nullptr) {
+        node->left->parent = par;
+      }
+      node->left = par;
     }
-    node_type* temp = base_node_.left;
-    while (temp != nullptr) {
-      if (comp(leaf->key, temp->key)) {
-        if (base_node_.right == temp) {
-          base_node_.right = leaf;
-          leaf->parent = temp;
-          temp->left = leaf;
-          break;
-        } else if (temp->left != nullptr) {
-          temp = temp->left;
-        } else {
-          leaf->parent = temp;
-          temp->left = leaf;
-          break;
-        }
-      } else {
-        if (temp->right != nullptr) {
-          temp = temp->right;
+    replace_child_(par, node);
+    par->parent = node;
+  }
+
+  void splay_(node_type* node) {
+    while (base_node_.left != node) {
+      node_type* par = node->parent;
+      if (base_node_.left != par) {
+        node_type* grand = par->parent;
+        if ((grand->left == par) == (par->left == node)) {
+          rotate_up_(par);
         } else {
-          leaf->parent = temp;
-          temp->right = leaf;
-          break;
+          rotate_up_(node);
         }
       }
+      rotate_up_(node);
     }
-    node_type* node = base_node_.left;
-    while (!(node->left == nullptr && node->right == nullptr)) {
-      if (node->left != nullptr) {
-        node = node->left;
-      } else {
-        node = node->right;
+    postorder_begin_.store(nullptr, std::memory_order_relaxed);
+  }
+
+  node_type* find_node_(const_reference value, node_type*& last) const {
+    if constexpr (multi_) {
+      node_type* node = lower_bound_node_(value, last);
+      if (node == nullptr || less_(value, node->key)) {
+        return nullptr;
       }
+      return node;
     }
-    base_node_.parent = node;
-    return std::make_pair(iterator<traversal_type>{leaf}, true);
+    bool to_left;
+    node_type* node = locate_(value, last, to_left);
+    return node;
   }
 
-  template <typename It>
-  void insert(It it1, It it2) {
-    for (auto it = it1; it != it2; ++it) {
-      insert(*it);
+  template <typename Key>
+  node_type* locate_(const Key& key, node_type*& parent, bool& to_left) const {
+    node_type* temp = base_node_.left;
+    parent = nullptr;
+    to_left = true;
+    while (temp != nullptr) {
+      stats_.on_visit();
+      if (less_(key, temp->key)) {
+        parent = temp;
+        to_left = true;
+        temp = temp->left;
+      } else if (less_(temp->key, key)) {
+        parent = temp;
+        to_left = false;
+        temp = temp->right;
+      } else {
+        parent = temp;
+        return temp;
+      }
     }
+    return nullptr;
   }
 
-  void insert(const std::initializer_list<value_type>& il) {
-    insert(il.begin(), il.end());
+  template <typename Key>
+  node_type* lower_bound_node_(const Key& value, node_type*& last) const {
+    node_type* temp = base_node_.left;
+    node_type* best = nullptr;
+    last = nullptr;
+    while (temp != nullptr) {
+      stats_.on_visit();
+      last = temp;
+      if (!less_(temp->key, value)) {
+        best = temp;
+        temp = temp->left;
+      } else {
+        temp = temp->right;
+      }
+    }
+    return best;
   }
 
-  template <typename traversal_type = inorder_tag>
-  iterator<traversal_type> erase(iterator<traversal_type> it) {
-    --size_;
-    node_type* root = base_node_.left;
-    node_type* temp = const_cast<Node*>(static_cast<const Node*>(it.ptr));
-    node_type* par = temp->parent;
-    iterator<> it_copy = iterator<>{it.ptr};
-    ++it_copy;
-    ++it;
-    if (temp->left == nullptr && temp->right == nullptr) {
-      if (base_node_.left == temp) {
-        base_node_.left = nullptr;
-        base_node_.right = static_cast<Node*>(&base_node_);
-        base_node_.parent = static_cast<Node*>(&base_node_);
+  template <typename Key>
+  node_type* upper_bound_node_(const Key& value) const {
+    node_type* temp = base_node_.left;
+    node_type* best = nullptr;
+    while (temp != nullptr) {
+      stats_.on_visit();
+      if (less_(value, temp->key)) {
+        best = temp;
+        temp = temp->left;
       } else {
-        if (par->left == temp) {
-          par->left = nullptr;
-          if (base_node_.right == temp) {
-            base_node_.right = par;
-          }
-        } else {
-          par->right = nullptr;
-        }
+        temp = temp->right;
       }
-    } else if (temp->left == nullptr || temp->right == nullptr) {
-      if (temp->left == nullptr) {
-        if (base_node_.left == temp) {
-          root->right->parent = static_cast<Node*>(&base_node_);
-          root = root->right;
-          base_node_.left = root;
-          base_node_.right = root;
-        } else {
-          if (par->left == temp) {
-            par->left = temp->right;
-          } else {
-            par->right = temp->right;
-          }
-          temp->right->parent = par;
-        }
+    }
+    return best;
+  }
+
+  node_type* insert_node_(const_reference value) {
+    node_type* parent = nullptr;
+    bool to_left = true;
+    node_type* temp = base_node_.left;
+    while (temp != nullptr) {
+      stats_.on_visit();
+      parent = temp;
+      to_left = less_(value, temp->key);
+      temp = to_left ? temp->left : temp->right;
+    }
+    return link_new_(parent, to_left, value);
+  }
+
+  template <typename... Args>
+  node_type* link_new_(node_type* parent, bool to_left, Args&&... args) {
+    stats_.on_allocate();
+    node_type* leaf = alloc.allocate(1);
+    try {
+      AllocTraits::construct(alloc, leaf, std::in_place,
+                             std::forward<Args>(args)...);
+    } catch (...) {
+      alloc.deallocate(leaf, 1);
+      throw;
+    }
+    ++size_;
+    if (parent == nullptr) {
+      base_node_.left = leaf;
+      leaf->parent = static_cast<Node*>(&base_node_);
+    } else if (to_left) {
+      parent->left = leaf;
+      leaf->parent = parent;
+    } else {
+      parent->right = leaf;
+      leaf->parent = parent;
+    }
+    if (parent == nullptr || (to_left && base_node_.right == parent)) {
+      base_node_.right = leaf;
+    }
+    if constexpr (splaying_) {
+      splay_(leaf);
+    } else {
+      base_node_.parent = first_postorder_(base_node_.left);
+    }
+    return leaf;
+  }
+
+  template <typename traversal_type>
+  iterator<traversal_type> make_iterator_(const BaseNode* node) const {
+    return {node, stats_.climbs()};
+  }
+
+  void destroy_node_(node_type* node) {
+    stats_.on_deallocate();
+    AllocTraits::destroy(alloc, node);
+    alloc.deallocate(node, 1);
+  }
+
+  size_type destroy_subtree_(node_type* root) {
+    return destroy_subtree_(root,
+                            [this](node_type* node) { destroy_node_(node); });
+  }
+
+  template <typename Destroy>
+  static size_type destroy_subtree_(node_type* root, Destroy destroy) {
+    size_type destroyed = 0;
+    node_type* node = root;
+    while (node != nullptr) {
+      if (node->left != nullptr) {
+        node = node->left;
+      } else if (node->right != nullptr) {
+        node = node->right;
       } else {
-        if (base_node_.left == temp) {
-          root->left->parent = static_cast<Node*>(&base_node_);
-          root = root->left;
-          base_node_.left = root;
-        } else {
-          if (par->left == temp) {
-            par->left = temp->left;
+        node_type* par = node == root ? nullptr : node->parent;
+        if (par != nullptr) {
+          if (par->left == node) {
+            par->left = nullptr;
           } else {
-            par->right = temp->left;
+            par->right = nullptr;
           }
-          temp->left->parent = par;
         }
+        destroy(node);
+        ++destroyed;
+        node = par;
       }
-    } else {
-      Node* next = const_cast<Node*>(static_cast<const Node*>(it_copy.ptr));
-      if (it.ptr == it_copy.ptr) {
-        it = iterator<traversal_type>{temp};
-      }
-      std::swap(temp, next);
-      next->key = temp->key;
-      if (temp->parent->left == temp) {
-        temp->parent->left = temp->right;
-        if (temp->right != nullptr) {
-          temp->right->parent = temp->parent;
-        }
+    }
+    return destroyed;
+  }
+
+  void split_(node_type* root, const_reference key, node_type*& less,
+              node_type*& greater) {
+    less = nullptr;
+    greater = nullptr;
+    node_type** less_hook = &less;
+    node_type** greater_hook = &greater;
+    node_type* less_par = nullptr;
+    node_type* greater_par = nullptr;
+    node_type* node = root;
+    while (node != nullptr) {
+      stats_.on_visit();
+      if (less_(node->key, key)) {
+        *less_hook = node;
+        node->parent = less_par;
+        less_par = node;
+        less_hook = &node->right;
+        node = node->right;
       } else {
-        temp->parent->right = temp->right;
-        if (temp->right != nullptr) {
-          temp->right->parent = temp->parent;
-        }
+        *greater_hook = node;
+        node->parent = greater_par;
+        greater_par = node;
+        greater_hook = &node->left;
+        node = node->left;
       }
     }
-    if (size_ != 0) {
-      node_type* node = base_node_.left;
-      while (!(node->left == nullptr && node->right == nullptr)) {
-        if (node->left != nullptr) {
-          node = node->left;
-        } else {
-          node = node->right;
-        }
+    *less_hook = nullptr;
+    *greater_hook = nullptr;
+  }
+
+  static node_type* join_(node_type* less, node_type* greater) {
+    if (less == nullptr) {
+      return greater;
+    }
+    if (greater == nullptr) {
+      return less;
+    }
+    node_type* mid = leftmost_(greater);
+    if (mid != greater) {
+      mid->parent->left = mid->right;
+      if (mid->right != nullptr) {
+        mid->right->parent = mid->parent;
       }
-      base_node_.parent = node;
+      mid->right = greater;
+      greater->parent = mid;
     }
-    AllocTraits::destroy(alloc, temp);
-    alloc.deallocate(temp, 1);
-    if (size_ == 0) {
-      return end<traversal_type>();
+    mid->left = less;
+    less->parent = mid;
+    return mid;
+  }
+
+  size_type erase_between_(const_reference first, const T* last) {
+    node_type* less;
+    node_type* rest;
+    node_type* erased = nullptr;
+    node_type* greater = nullptr;
+    split_(base_node_.left, first, less, rest);
+    if (last == nullptr) {
+      erased = rest;
+    } else {
+      split_(rest, *last, erased, greater);
     }
-    return it;
+    size_type destroyed = destroy_subtree_(erased);
+    attach_root_(join_(less, greater), size_ - destroyed);
+    return destroyed;
   }
 
-  template <typename traversal_type = inorder_tag>
-  iterator<traversal_type> erase(iterator<traversal_type> it1,
-                                 iterator<traversal_type> it2) {
+  template <typename traversal_type>
+  iterator<traversal_type> erase_(iterator<traversal_type> it1,
+                                  iterator<traversal_type> it2,
+                                  traversal_type) {
     while (it1 != it2) {
       it1 = erase<traversal_type>(it1);
     }
     return it2;
   }
 
-  size_type erase(const_reference value) {
-    iterator<> it = find(value);
-    if (it == end()) {
-      return 0;
+  bool starts_run_(iterator<inorder_tag> it) const {
+    if (it == begin()) {
+      return true;
     }
-    erase(it);
-    return 1;
+    iterator<inorder_tag> prev = it;
+    --prev;
+    return less_(*prev, *it);
+  }
+
+  iterator<inorder_tag> erase_(iterator<inorder_tag> it1,
+                               iterator<inorder_tag> it2, inorder_tag) {
+    if (it1 == it2) {
+      return it2;
+    }
+    if constexpr (multi_) {
+      if (!starts_run_(it1) || (it2 != end() && !starts_run_(it2))) {
+        while (it1 != it2) {
+          it1 = erase(it1);
+        }
+        return it2;
+      }
+    }
+    const T* last = nullptr;
+    if (it2 != end()) {
+      last = &*it2;
+    }
+    erase_between_(*it1, last);
+    return it2;
   }
 
-  void clear() { erase(begin(), end()); }
+  template <typename Item>
+  struct Stack {
+    using ItemAlloc =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Item>;
+    using ItemAllocTraits = std::allocator_traits<ItemAlloc>;
 
-  template <typename traversal_type = inorder_tag>
-  iterator<traversal_type> find(const_reference value) const {
-    if (base_node_.left == nullptr) {
-      return end<traversal_type>();
+    ItemAlloc alloc;
+    Item* data;
+    size_type size;
+    size_type capacity;
+
+    Stack(const ItemAlloc& alloc)
+        : alloc(alloc), data(nullptr), size(0), capacity(0) {}
+
+    Stack(const Stack&) = delete;
+    Stack& operator=(const Stack&) = delete;
+
+    ~Stack() {
+      if (data != nullptr) {
+        ItemAllocTraits::deallocate(alloc, data, capacity);
+      }
     }
-    node_type* temp = base_node_.left;
-    while (temp != nullptr && value != temp->key) {
-      if (comp(value, temp->key)) {
-        temp = temp->left;
-      } else {
-        temp = temp->right;
+
+    bool empty() const { return size == 0; }
+
+    void push(const Item& item) {
+      if (size == capacity) {
+        size_type grown = capacity == 0 ? 16 : 2 * capacity;
+        Item* moved = ItemAllocTraits::allocate(alloc, grown);
+        std::copy(data, data + size, moved);
+        if (data != nullptr) {
+          ItemAllocTraits::deallocate(alloc, data, capacity);
+        }
+        data = moved;
+        capacity = grown;
       }
+      data[size] = item;
+      ++size;
     }
-    if (temp == nullptr) {
-      return end<traversal_type>();
+
+    Item pop() {
+      --size;
+      return data[size];
+    }
+  };
+
+  template <typename Item>
+  struct Queue {
+    using ItemAlloc =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Item>;
+    using ItemAllocTraits = std::allocator_traits<ItemAlloc>;
+
+    ItemAlloc alloc;
+    Item* data;
+    size_type head;
+    size_type size;
+    size_type capacity;
+
+    Queue(const ItemAlloc& alloc)
+        : alloc(alloc), data(nullptr), head(0), size(0), capacity(0) {}
+
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
+    ~Queue() {
+      if (data != nullptr) {
+        ItemAllocTraits::deallocate(alloc, data, capacity);
+      }
+    }
+
+    bool empty() const { return size == 0; }
+
+    void push(const Item& item) {
+      if (size == capacity) {
+        size_type grown = capacity == 0 ? 16 : 2 * capacity;
+        Item* moved = ItemAllocTraits::allocate(alloc, grown);
+        for (size_type i = 0; i < size; ++i) {
+          moved[i] = data[(head + i) % capacity];
+        }
+        if (data != nullptr) {
+          ItemAllocTraits::deallocate(alloc, data, capacity);
+        }
+        data = moved;
+        head = 0;
+        capacity = grown;
+      }
+      data[(head + size) % capacity] = item;
+      ++size;
+    }
+
+    Item pop() {
+      Item item = data[head];
+      head = (head + 1) % capacity;
+      --size;
+      return item;
+    }
+  };
+
+  struct BatchFrame {
+    node_type* node;
+    T* first;
+    T* last;
+    bool unlink;
+  };
+
+  size_type insert_sorted_(node_type* root, T* first, T* last) {
+    size_type inserted = 0;
+    Stack<BatchFrame> stack(alloc);
+    stack.push({root, first, last, false});
+    while (!stack.empty()) {
+      BatchFrame frame = stack.pop();
+      node_type* node = frame.node;
+      first = frame.first;
+      last = frame.last;
+      while (first != last) {
+        stats_.on_visit();
+        T* mid = std::lower_bound(first, last, node->key, counted_less_());
+        T* next = mid;
+        if (!multi_ && next != last && !less_(node->key, *next)) {
+          ++next;
+        }
+        if (first != mid) {
+          if (node->left == nullptr) {
+            node->left = build_(first, mid - first, node, alloc, 0);
+            stats_.on_allocate(mid - first);
+            size_ += mid - first;
+            inserted += mid - first;
+          } else {
+            stack.push({node->left, first, mid, false});
+          }
+        }
+        first = next;
+        if (first != last && node->right == nullptr) {
+          node->right = build_(first, last - first, node, alloc, 0);
+          stats_.on_allocate(last - first);
+          size_ += last - first;
+          inserted += last - first;
+          break;
+        }
+        node = node->right;
+      }
     }
-    return {temp};
+    return inserted;
   }
 
-  size_type count(const_reference value) const {
-    if (contains(value)) {
-      return 1;
+  size_type erase_sorted_(node_type* root, T* first, T* last) {
+    size_type erased = 0;
+    Stack<BatchFrame> stack(alloc);
+    stack.push({root, first, last, false});
+    while (!stack.empty()) {
+      BatchFrame frame = stack.pop();
+      node_type* node = frame.node;
+      if (frame.unlink) {
+        unlink_(node);
+        destroy_node_(node);
+        ++erased;
+        continue;
+      }
+      stats_.on_visit();
+      T* mid = std::lower_bound(frame.first, frame.last, node->key,
+                                counted_less_());
+      bool hit = mid != frame.last && !less_(node->key, *mid);
+      if (hit) {
+        stack.push({node, frame.first, frame.last, true});
+      }
+      T* left_last = multi_ && hit ? mid + 1 : mid;
+      T* right_first = !multi_ && hit ? mid + 1 : mid;
+      if (frame.first != left_last && node->left != nullptr) {
+        stack.push({node->left, frame.first, left_last, false});
+      }
+      if (right_first != frame.last && node->right != nullptr) {
+        stack.push({node->right, right_first, frame.last, false});
+      }
     }
-    return 0;
+    return erased;
   }
 
-  bool contains(const_reference value) const {
-    if (find(value) == end()) {
-      return false;
+  struct ScanFrame {
+    node_type* node;
+    const T* least;
+    const T* greatest;
+  };
+
+  template <typename R, typename BinaryOp>
+  static void append_(std::optional<R>& acc, BinaryOp& reduce, R&& part) {
+    if (acc.has_value()) {
+      acc = reduce(std::move(*acc), std::move(part));
+    } else {
+      acc.emplace(std::move(part));
     }
-    return true;
   }
 
-  template <typename traversal_type = inorder_tag>
-  iterator<traversal_type> lower_bound(const_reference value) const {
-    if (base_node_.left == nullptr) {
-      return end();
+  template <typename R, typename BinaryOp>
+  static R combine_(BinaryOp& reduce, std::optional<R>& left, R&& self,
+                    std::optional<R>& right, inorder_tag) {
+    std::optional<R> acc;
+    if (left.has_value()) {
+      append_(acc, reduce, std::move(*left));
     }
-    node_type* temp = base_node_.left;
-    node_type* best = nullptr;
-    while (temp != nullptr) {
-      if (!comp(temp->key, value) &&
-          (best == nullptr || comp(temp->key, best->key))) {
-        best = temp;
-      }
-      if (comp(value, temp->key)) {
-        temp = temp->left;
-      } else {
-        temp = temp->right;
-      }
+    append_(acc, reduce, std::move(self));
+    if (right.has_value()) {
+      append_(acc, reduce, std::move(*right));
     }
-    if (best == nullptr) {
-      return end();
+    return std::move(*acc);
+  }
+
+  template <typename R, typename BinaryOp>
+  static R combine_(BinaryOp& reduce, std::optional<R>& left, R&& self,
+                    std::optional<R>& right, preorder_tag) {
+    std::optional<R> acc;
+    append_(acc, reduce, std::move(self));
+    if (left.has_value()) {
+      append_(acc, reduce, std::move(*left));
+    }
+    if (right.has_value()) {
+      append_(acc, reduce, std::move(*right));
     }
-    return {best};
+    return std::move(*acc);
   }
 
-  template <typename traversal_type = inorder_tag>
-  iterator<traversal_type> upper_bound(const_reference value) const {
-    if (base_node_.left == nullptr) {
-      return end();
+  template <typename R, typename BinaryOp>
+  static R combine_(BinaryOp& reduce, std::optional<R>& left, R&& self,
+                    std::optional<R>& right, postorder_tag) {
+    std::optional<R> acc;
+    if (left.has_value()) {
+      append_(acc, reduce, std::move(*left));
     }
-    node_type* temp = base_node_.left;
-    node_type* best = nullptr;
-    while (temp != nullptr) {
-      if (comp(value, temp->key) &&
-          (best == nullptr || comp(temp->key, best->key))) {
-        best = temp;
+    if (right.has_value()) {
+      append_(acc, reduce, std::move(*right));
+    }
+    append_(acc, reduce, std::move(self));
+    return std::move(*acc);
+  }
+
+  template <typename traversal_type, typename R, typename BinaryOp,
+            typename UnaryOp>
+  static R transform_reduce_(node_type* root, BinaryOp& reduce,
+                             UnaryOp& transform, size_type depth) {
+    if (depth == 0) {
+      node_type* node = subtree_begin_(root, traversal_type{});
+      R acc = transform(node->key);
+      node = subtree_next_(node, root, traversal_type{});
+      while (node != nullptr) {
+        acc = reduce(std::move(acc), transform(node->key));
+        node = subtree_next_(node, root, traversal_type{});
       }
-      if (comp(value, temp->key)) {
-        temp = temp->left;
-      } else {
-        temp = temp->right;
+      return acc;
+    }
+    std::future<R> left_task;
+    if (root->left != nullptr) {
+      left_task = std::async(std::launch::async, [&reduce, &transform, root,
+                                                  depth]() {
+        return transform_reduce_<traversal_type, R>(root->left, reduce,
+                                                    transform, depth - 1);
+      });
+    }
+    std::optional<R> right;
+    if (root->right != nullptr) {
+      right.emplace(transform_reduce_<traversal_type, R>(
+          root->right, reduce, transform, depth - 1));
+    }
+    std::optional<R> left;
+    if (left_task.valid()) {
+      left.emplace(left_task.get());
+    }
+    return combine_(reduce, left, R(transform(root->key)), right,
+                    traversal_type{});
+  }
+
+  template <typename traversal_type, typename UnaryFunction>
+  static void for_each_(node_type* root, UnaryFunction& f, size_type depth) {
+    if (depth == 0) {
+      node_type* node = subtree_begin_(root, traversal_type{});
+      while (node != nullptr) {
+        f(static_cast<const_reference>(node->key));
+        node = subtree_next_(node, root, traversal_type{});
       }
+      return;
     }
-    if (best == nullptr) {
-      return end();
+    std::future<void> left_task;
+    if (root->left != nullptr) {
+      left_task = std::async(std::launch::async, [&f, root, depth]() {
+        for_each_<traversal_type>(root->left, f, depth - 1);
+      });
+    }
+    f(static_cast<const_reference>(root->key));
+    if (root->right != nullptr) {
+      for_each_<traversal_type>(root->right, f, depth - 1);
+    }
+    if (left_task.valid()) {
+      left_task.get();
     }
-    return {best};
   }
 
-  template <typename traversal_type = inorder_tag>
-  std::pair<iterator<traversal_type>, iterator<traversal_type>> equal_range(
-      const_reference value) const {
-    return std::make_pair(lower_bound(value), upper_bound(value));
+ public:
+  BinarySearchTree(Compare comp = Compare(), Allocator alloc = Allocator())
+      : base_node_(), size_(0), comp(comp), alloc(alloc) {
+    base_node_.parent = static_cast<Node*>(&base_node_);
+    base_node_.right = static_cast<Node*>(&base_node_);
   }
-};
 
-template <typename T, typename Compare = std::less<T>,
-          typename Allocator = std::allocator<T>>
-bool operator==(const BinarySearchTree<T, Compare, Allocator>& first,
-                const BinarySearchTree<T, Compare, Allocator>& second) {
-  if (first.size() != second.size()) {
-    return false;
-  }
-  auto it1 = first.template begin<preorder_tag>();
-  auto it2 = second.template begin<preorder_tag>();
-  for (size_t i = 0; i < first.size(); ++i) {
-    if (*it1 != *it2) {
-      return false;
-    }
-    ++it1;
-    ++it2;
+  template <typename It>
+  BinarySearchTree(It it1, It it2, Compare comp = Compare(),
+                   Allocator alloc = Allocator())
+      : base_node_(), size_(0), comp(comp), alloc(alloc) {
+    base_node_.parent = static_cast<Node*>(&base_node_);
+    base_node_.right = static_cast<Node*>(&base_node_);
+    insert(it1, it2);
   }
-  return true;
-}
 
-template <typename T, typename Compare = std::less<T>,
-          typename Allocator = std::allocator<T>>
-bool operator!=(const BinarySearchTree<T, Compare, Allocator>& first,
-                const BinarySearchTree<T, Compare, Allocator>& second) {
-  return !(first == second);
-}
+  BinarySearchTree(const std::initializer_list<value_type>& il,
+                   Compare comp = Compare(), Allocator alloc = Allocator())
+      : base_node_(), size_(0), comp(comp), alloc(alloc) {
+    base_node_.parent = static_cast<Node*>(&base_node_);
+    base_node_.right = static_cast<Node*>(&base_node_);
+    insert(il);
+  }
 
-template <typename T, typename Compare = std::less<T>,
-          typename Allocator = std::allocator<T>>
-void swap(BinarySearchTree<T, Compare, Allocator>& first,
-          BinarySearchTree<T, Compare, Allocator>& second) {
-  first.swap(second);
-}
\ No newline at end of file
+  BinarySearchTree(const BinarySearchTree& other)
+      : base_node_(), size_(0), comp(other.comp), alloc(other.alloc) {
+    base_node_.parent = static_cast<Node*>(&base_node_);
+    base_node_.right = static_cast<Node*>(&base_node_);
+    insert(other.begin<preorder_tag>(), other.end<preorder_tag>());
+  }
+
+  BinarySearchTree& operator=(const BinarySearchTree& other) {
+    if (this == &other) {
+      return *this;
+    }
+    clear();
+    comp = other.comp;
+    alloc = other.alloc;
+    for (auto it = other.begin<preorder_tag>(); it != other.end<preorder_tag>();
+         ++it) {
+      insert(*it);
+    }
+    return *this;
+  }
+
+  BinarySearchTree& operator=(std::initializer_list<value_type> il) {
+    clear();
+    comp = Compare();
+    alloc = Allocator();
+    insert(il);
+    return *this;
+  }
+
+  ~BinarySearchTree() { clear(); }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> begin() {
+    return make_iterator_<traversal_type>(begin_(traversal_type{}));
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> end() {
+    return make_iterator_<traversal_type>(&base_node_);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> begin() const {
+    return make_iterator_<traversal_type>(begin_(traversal_type{}));
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> end() const {
+    return make_iterator_<traversal_type>(&base_node_);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> cbegin() const {
+    return make_iterator_<traversal_type>(begin_(traversal_type{}));
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> cend() const {
+    return make_iterator_<traversal_type>(&base_node_);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  reverse_iterator<traversal_type> rbegin() {
+    return reverse_iterator<traversal_type>(end<traversal_type>());
+  }
+
+  template <typename traversal_type = inorder_tag>
+  reverse_iterator<traversal_type> rend() {
+    return reverse_iterator<traversal_type>(begin<traversal_type>());
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_reverse_iterator<traversal_type> rbegin() const {
+    return const_reverse_iterator<traversal_type>(end<traversal_type>());
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_reverse_iterator<traversal_type> rend() const {
+    return const_reverse_iterator<traversal_type>(begin<traversal_type>());
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_reverse_iterator<traversal_type> crbegin() const {
+    return const_reverse_iterator<traversal_type>(end<traversal_type>());
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_reverse_iterator<traversal_type> crend() const {
+    return const_reverse_iterator<traversal_type>(begin<traversal_type>());
+  }
+
+  void swap(BinarySearchTree& other) {
+    if (this == &other) {
+      return;
+    }
+    if (base_node_.left != nullptr) {
+      base_node_.left->parent = static_cast<Node*>(&(other.base_node_));
+    }
+    if (other.base_node_.left != nullptr) {
+      other.base_node_.left->parent = static_cast<Node*>(&base_node_);
+    }
+    std::swap(base_node_, other.base_node_);
+    std::swap(size_, other.size_);
+    std::swap(comp, other.comp);
+    std::swap(alloc, other.alloc);
+    if constexpr (splaying_) {
+      base_node_.parent = static_cast<Node*>(&base_node_);
+      other.base_node_.parent = static_cast<Node*>(&other.base_node_);
+      postorder_begin_.store(nullptr, std::memory_order_relaxed);
+      other.postorder_begin_.store(nullptr, std::memory_order_relaxed);
+    }
+    if (base_node_.left == nullptr) {
+      base_node_.right = static_cast<Node*>(&base_node_);
+      base_node_.parent = static_cast<Node*>(&base_node_);
+    }
+    if (other.base_node_.left == nullptr) {
+      other.base_node_.right = static_cast<Node*>(&other.base_node_);
+      other.base_node_.parent = static_cast<Node*>(&other.base_node_);
+    }
+  }
+
+  size_type size() const { return size_; }
+
+  size_type max_size() const { return std::numeric_limits<size_type>::max(); }
+
+  bool empty() const { return begin() == end(); }
+
+  key_compare key_comp() const { return comp; }
+
+  value_compare value_comp() const { return comp; }
+
+  template <typename traversal_type = inorder_tag>
+  std::pair<iterator<traversal_type>, bool> insert(const_reference value)
+    requires(!std::is_same_v<Uniqueness, multi_keys>)
+  {
+    iterator<traversal_type> it = find<traversal_type>(value);
+    if (it != end<traversal_type>()) {
+      return std::make_pair(it, false);
+    }
+    return std::make_pair(make_iterator_<traversal_type>(insert_node_(value)),
+                          true);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> insert(const_reference value)
+    requires std::is_same_v<Uniqueness, multi_keys>
+  {
+    return make_iterator_<traversal_type>(insert_node_(value));
+  }
+
+  void serialize(std::ostream& out) const
+    requires std::is_trivially_copyable_v<T>
+  {
+    std::uint64_t checksum = bst_file_header::hash_seed;
+    for (auto it = begin(); it != end(); ++it) {
+      checksum = bst_file_header::hash(checksum, &*it, sizeof(T));
+    }
+    bst_file_header header = bst_file_header::make<T>(size_, checksum);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto it = begin(); it != end(); ++it) {
+      out.write(reinterpret_cast<const char*>(&*it), sizeof(T));
+    }
+    if (!out) {
+      throw std::runtime_error("bst: write failed");
+    }
+  }
+
+  void deserialize(std::istream& in)
+    requires std::is_trivially_copyable_v<T>
+  {
+    bst_file_header header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+      throw std::runtime_error("bst: truncated header");
+    }
+    header.check<T>();
+    Buffer buffer{ValueAlloc(alloc)};
+    if (header.count > ValueAllocTraits::max_size(buffer.alloc)) {
+      throw std::runtime_error("bst: payload count is out of range");
+    }
+    size_type count = header.count;
+    size_type chunk = std::max<size_type>(1, (size_type(1) << 16) / sizeof(T));
+    std::uint64_t checksum = bst_file_header::hash_seed;
+    while (buffer.constructed < count) {
+      buffer.reserve_(std::min(count, std::max(chunk, 2 * buffer.capacity)));
+      size_type step = buffer.capacity - buffer.constructed;
+      T* slot = buffer.data + buffer.constructed;
+      if (!in.read(reinterpret_cast<char*>(slot), step * sizeof(T))) {
+        throw std::runtime_error("bst: truncated payload");
+      }
+      checksum = bst_file_header::hash(checksum, slot, step * sizeof(T));
+      buffer.constructed += step;
+    }
+    buffer.size = count;
+    if (checksum != header.checksum) {
+      throw std::runtime_error("bst: checksum mismatch");
+    }
+    T* data = buffer.data;
+    if (std::adjacent_find(data, data + count,
+                           [this](const_reference lhs, const_reference rhs) {
+                             return multi_ ? comp(rhs, lhs) : !comp(lhs, rhs);
+                           }) != data + count) {
+      throw std::runtime_error("bst: payload is not strictly ordered");
+    }
+    node_type* root = build_(data, count, nullptr, alloc, build_depth_(count));
+    clear();
+    stats_.on_allocate(count);
+    attach_root_(root, count);
+  }
+
+  template <typename It>
+  void bulk_load(It first, It last) {
+    Buffer buffer(first, last, ValueAlloc(alloc));
+    sort_unique_(buffer);
+    node_type* root = build_(buffer.data, buffer.size, nullptr, alloc,
+                             build_depth_(buffer.size));
+    clear();
+    stats_.on_allocate(buffer.size);
+    attach_root_(root, buffer.size);
+  }
+
+  template <typename It>
+  size_type insert_batch(It first, It last) {
+    Buffer buffer(first, last, ValueAlloc(alloc));
+    sort_unique_(buffer);
+    if (buffer.size == 0) {
+      return 0;
+    }
+    if (base_node_.left == nullptr) {
+      node_type* root = build_(buffer.data, buffer.size, nullptr, alloc,
+                               build_depth_(buffer.size));
+      stats_.on_allocate(buffer.size);
+      attach_root_(root, buffer.size);
+      return buffer.size;
+    }
+    size_type inserted;
+    try {
+      inserted = insert_sorted_(base_node_.left, buffer.data,
+                                buffer.data + buffer.size);
+    } catch (...) {
+      refresh_ends_();
+      throw;
+    }
+    refresh_ends_();
+    return inserted;
+  }
+
+  template <typename It>
+  size_type erase_batch(It first, It last) {
+    if (base_node_.left == nullptr) {
+      return 0;
+    }
+    Buffer buffer(first, last, ValueAlloc(alloc));
+    sort_unique_(buffer, false);
+    if (buffer.size == 0) {
+      return 0;
+    }
+    size_type erased =
+        erase_sorted_(base_node_.left, buffer.data, buffer.data + buffer.size);
+    size_ -= erased;
+    refresh_ends_();
+    return erased;
+  }
+
+  template <typename It>
+  void insert(It it1, It it2) {
+    for (auto it = it1; it != it2; ++it) {
+      insert(*it);
+    }
+  }
+
+  void insert(const std::initializer_list<value_type>& il) {
+    insert(il.begin(), il.end());
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> erase(iterator<traversal_type> it) {
+    node_type* node = const_cast<Node*>(static_cast<const Node*>(it.ptr));
+    ++it;
+    unlink_(node);
+    --size_;
+    destroy_node_(node);
+    refresh_ends_();
+    return it;
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> erase(iterator<traversal_type> it1,
+                                 iterator<traversal_type> it2) {
+    return erase_(it1, it2, traversal_type{});
+  }
+
+  size_type erase_range(const_reference first, const_reference last) {
+    if (base_node_.left == nullptr || !comp(first, last)) {
+      return 0;
+    }
+    return erase_between_(first, &last);
+  }
+
+  size_type erase(const_reference value) {
+    if constexpr (multi_) {
+      node_type* last;
+      node_type* first = find_node_(value, last);
+      if (first == nullptr) {
+        return 0;
+      }
+      node_type* bound = upper_bound_node_(value);
+      return erase_between_(value, bound == nullptr ? nullptr : &bound->key);
+    }
+    iterator<> it = find(value);
+    if (it == end()) {
+      return 0;
+    }
+    erase(it);
+    return 1;
+  }
+
+  void clear() {
+    destroy_subtree_(base_node_.left);
+    attach_root_(nullptr, 0);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> find(const_reference value) const {
+    node_type* last;
+    node_type* node = find_node_(value, last);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return make_iterator_<traversal_type>(node);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> find(const_reference value)
+    requires std::is_same_v<Access, splay_access>
+  {
+    node_type* last;
+    node_type* node = find_node_(value, last);
+    if (last != nullptr) {
+      splay_(last);
+    }
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return make_iterator_<traversal_type>(node);
+  }
+
+  size_type count(const_reference value) const {
+    if constexpr (multi_) {
+      size_type result = 0;
+      for (iterator<> it = find(value); it != end() && !less_(value, *it);
+           ++it) {
+        ++result;
+      }
+      return result;
+    }
+    if (contains(value)) {
+      return 1;
+    }
+    return 0;
+  }
+
+  bool contains(const_reference value) const {
+    if (find(value) == end()) {
+      return false;
+    }
+    return true;
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> lower_bound(const_reference value) const {
+    node_type* last;
+    node_type* node = lower_bound_node_(value, last);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return make_iterator_<traversal_type>(node);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> lower_bound(const_reference value)
+    requires std::is_same_v<Access, splay_access>
+  {
+    node_type* last;
+    node_type* node = lower_bound_node_(value, last);
+    if (node != nullptr) {
+      splay_(node);
+      return make_iterator_<traversal_type>(node);
+    }
+    if (last != nullptr) {
+      splay_(last);
+    }
+    return end<traversal_type>();
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> upper_bound(const_reference value) const {
+    node_type* node = upper_bound_node_(value);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return make_iterator_<traversal_type>(node);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  std::pair<iterator<traversal_type>, iterator<traversal_type>> equal_range(
+      const_reference value) const {
+    return std::make_pair(lower_bound(value), upper_bound(value));
+  }
+
+  template <typename traversal_type = inorder_tag>
+  std::ranges::subrange<const_iterator<traversal_type>> view() const {
+    return {begin<traversal_type>(), end<traversal_type>()};
+  }
+
+  std::ranges::subrange<const_iterator<>> range(const_reference first,
+                                                const_reference last) const {
+    const_iterator<> lower = lower_bound(first);
+    if (!less_(first, last)) {
+      return {lower, lower};
+    }
+    return {lower, lower_bound(last)};
+  }
+
+  bst_generator<T> level_order() const {
+    Queue<node_type*> queue(alloc);
+    if (base_node_.left != nullptr) {
+      queue.push(base_node_.left);
+    }
+    while (!queue.empty()) {
+      node_type* node = queue.pop();
+      if (node->left != nullptr) {
+        queue.push(node->left);
+      }
+      if (node->right != nullptr) {
+        queue.push(node->right);
+      }
+      co_yield node->key;
+    }
+  }
+
+  template <typename Pred>
+  bst_generator<T> scan(Pred may_contain) const {
+    Stack<ScanFrame> stack(alloc);
+    node_type* node = base_node_.left;
+    const T* least = nullptr;
+    const T* greatest = nullptr;
+    while (true) {
+      while (node != nullptr && may_contain(least, greatest)) {
+        stack.push({node, least, greatest});
+        greatest = &node->key;
+        node = node->left;
+      }
+      if (stack.empty()) {
+        co_return;
+      }
+      ScanFrame frame = stack.pop();
+      co_yield frame.node->key;
+      node = frame.node->right;
+      least = &frame.node->key;
+      greatest = frame.greatest;
+    }
+  }
+
+  tree_statistics tree_stats() const {
+    tree_statistics stats;
+    stats_.report(stats);
+    stats.size = size_;
+    stats.bytes = sizeof(*this) + size_ * sizeof(Node);
+    node_type* root = base_node_.left;
+    node_type* node = root;
+    size_type depth = 0;
+    size_type path_length = 0;
+    while (node != nullptr) {
+      path_length += depth + 1;
+      stats.height = std::max(stats.height, depth + 1);
+      ++stats.depth_histogram[std::min(depth,
+                                       tree_statistics::depth_buckets - 1)];
+      if (node->left != nullptr) {
+        node = node->left;
+        ++depth;
+      } else if (node->right != nullptr) {
+        node = node->right;
+        ++depth;
+      } else {
+        while (node != root && (node->parent->right == node ||
+                                node->parent->right == nullptr)) {
+          node = node->parent;
+          --depth;
+        }
+        node = node == root ? nullptr : node->parent->right;
+      }
+    }
+    if (size_ != 0) {
+      stats.average_path_length = static_cast<double>(path_length) / size_;
+    }
+    return stats;
+  }
+
+  template <typename traversal_type = inorder_tag, typename R,
+            typename BinaryOp, typename UnaryOp>
+  R parallel_transform_reduce(R init, BinaryOp reduce,
+                              UnaryOp transform) const {
+    if (base_node_.left == nullptr) {
+      return init;
+    }
+    return reduce(std::move(init),
+                  transform_reduce_<traversal_type, R>(
+                      base_node_.left, reduce, transform, parallel_depth_(size_)));
+  }
+
+  template <typename traversal_type = inorder_tag, typename BinaryOp>
+  value_type parallel_reduce(value_type init, BinaryOp reduce) const {
+    return parallel_transform_reduce<traversal_type>(
+        std::move(init), reduce,
+        [](const_reference value) -> value_type { return value; });
+  }
+
+  template <typename UnaryPredicate>
+  size_type parallel_count_if(UnaryPredicate pred) const {
+    return parallel_transform_reduce(
+        size_type{0}, std::plus<size_type>{},
+        [&pred](const_reference value) -> size_type {
+          return pred(value) ? 1 : 0;
+        });
+  }
+
+  template <typename traversal_type = inorder_tag, typename UnaryFunction>
+  void parallel_for_each(UnaryFunction f) const {
+    if (base_node_.left != nullptr) {
+      for_each_<traversal_type>(base_node_.left, f, parallel_depth_(size_));
+    }
+  }
+
+  friend bool operator==(const BinarySearchTree& first,
+                         const BinarySearchTree& second) {
+    if (&first == &second) {
+      return true;
+    }
+    if (first.size_ != second.size_) {
+      return false;
+    }
+    node_type* lhs = first.base_node_.left == nullptr ? nullptr
+                                                       : first.base_node_.right;
+    node_type* rhs = second.base_node_.right;
+    while (lhs != nullptr) {
+      if (!(lhs->key == rhs->key)) {
+        return false;
+      }
+      lhs = subtree_next_(lhs, first.base_node_.left, inorder_tag{});
+      rhs = subtree_next_(rhs, second.base_node_.left, inorder_tag{});
+    }
+    return true;
+  }
+
+  friend auto operator<=>(const BinarySearchTree& first,
+                          const BinarySearchTree& second) {
+    using ordering = decltype(synth_three_way_(std::declval<const_reference>(),
+                                               std::declval<const_reference>()));
+    if (&first == &second) {
+      return ordering::equivalent;
+    }
+    node_type* lhs = first.base_node_.left == nullptr ? nullptr
+                                                       : first.base_node_.right;
+    node_type* rhs = second.base_node_.left == nullptr
+                         ? nullptr
+                         : second.base_node_.right;
+    while (lhs != nullptr && rhs != nullptr) {
+      ordering result = synth_three_way_(lhs->key, rhs->key);
+      if (result != 0) {
+        return result;
+      }
+      lhs = subtree_next_(lhs, first.base_node_.left, inorder_tag{});
+      rhs = subtree_next_(rhs, second.base_node_.left, inorder_tag{});
+    }
+    return static_cast<ordering>(first.size_ <=> second.size_);
+  }
+};
+
+template <typename T, typename Compare, typename Allocator, typename Stats,
+          typename Access, typename Uniqueness>
+void swap(
+    BinarySearchTree<T, Compare, Allocator, Stats, Access, Uniqueness>& first,
+    BinarySearchTree<T, Compare, Allocator, Stats, Access, Uniqueness>&
+        second) {
+  first.swap(second);
+}
+
+template <typename T, typename Compare = std::less<T>,
+          typename Allocator = std::allocator<T>, typename Stats = no_stats>
+using SplayTree = BinarySearchTree<T, Compare, Allocator, Stats, splay_access>;
+
+template <typename T, typename Compare = std::less<T>,
+          typename Allocator = std::allocator<T>, typename Stats = no_stats>
+using BinarySearchMultiTree =
+    BinarySearchTree<T, Compare, Allocator, Stats, static_access, multi_keys>;
+
+template <typename Key, typename Value, typename Compare, typename Allocator,
+          typename Stats>
+class BinarySearchTreeMap {
+ public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<const Key, Value>;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using key_compare = Compare;
+  using allocator_type = Allocator;
+  using size_type = size_t;
+
+  class value_compare {
+    friend BinarySearchTreeMap;
+
+   private:
+    Compare comp;
+    value_compare(Compare comp) : comp(comp) {}
+
+   public:
+    bool operator()(const value_type& lhs, const value_type& rhs) const {
+      return comp(lhs.first, rhs.first);
+    }
+    bool operator()(const Key& lhs, const value_type& rhs) const {
+      return comp(lhs, rhs.first);
+    }
+    bool operator()(const value_type& lhs, const Key& rhs) const {
+      return comp(lhs.first, rhs);
+    }
+  };
+
+ private:
+  using tree_type =
+      BinarySearchTree<value_type, value_compare, Allocator, Stats>;
+  using node_type = typename tree_type::node_type;
+
+  template <typename traversal_type>
+  using tree_iterator = typename tree_type::template iterator<traversal_type>;
+
+  template <typename traversal_type = inorder_tag>
+  class map_iterator {
+    friend BinarySearchTreeMap;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = BinarySearchTreeMap::value_type;
+    using key_type = const Key;
+    using pointer = value_type*;
+    using reference = value_type&;
+    using pointer_type = value_type*;
+    using reference_type = value_type&;
+    using difference_type = std::ptrdiff_t;
+
+   private:
+    tree_iterator<traversal_type> it;
+    map_iterator(tree_iterator<traversal_type> it) : it(it) {}
+
+   public:
+    map_iterator() = default;
+    map_iterator(const map_iterator&) = default;
+    map_iterator& operator=(const map_iterator&) = default;
+
+    bool operator==(const map_iterator& other) const = default;
+    bool operator!=(const map_iterator& other) const = default;
+
+    operator tree_iterator<traversal_type>() const { return it; }
+
+    reference_type operator*() const {
+      return const_cast<reference_type>(*it);
+    }
+    pointer_type operator->() const { return &**this; }
+
+    map_iterator& operator++() {
+      ++it;
+      return *this;
+    }
+
+    map_iterator operator++(int) {
+      map_iterator copy = *this;
+      ++it;
+      return copy;
+    }
+
+    map_iterator& operator--() {
+      --it;
+      return *this;
+    }
+
+    map_iterator operator--(int) {
+      map_iterator copy = *this;
+      --it;
+      return copy;
+    }
+  };
+
+  tree_type tree_;
+
+  template <typename traversal_type>
+  map_iterator<traversal_type> wrap_(const node_type* node) const {
+    return tree_.template make_iterator_<traversal_type>(node);
+  }
+
+ public:
+  template <typename traversal_type = inorder_tag>
+  using iterator = map_iterator<traversal_type>;
+  template <typename traversal_type = inorder_tag>
+  using const_iterator = tree_iterator<traversal_type>;
+
+  BinarySearchTreeMap(Compare comp = Compare(), Allocator alloc = Allocator())
+      : tree_(value_compare(comp), alloc) {}
+
+  BinarySearchTreeMap(const std::initializer_list<value_type>& il,
+                      Compare comp = Compare(), Allocator alloc = Allocator())
+      : tree_(il, value_compare(comp), alloc) {}
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> begin() {
+    return tree_.template begin<traversal_type>();
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> end() {
+    return tree_.template end<traversal_type>();
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> begin() const {
+    return tree_.template begin<traversal_type>();
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> end() const {
+    return tree_.template end<traversal_type>();
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> cbegin() const {
+    return tree_.template cbegin<traversal_type>();
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> cend() const {
+    return tree_.template cend<traversal_type>();
+  }
+
+  size_type size() const { return tree_.size(); }
+
+  size_type max_size() const { return tree_.max_size(); }
+
+  bool empty() const { return tree_.empty(); }
+
+  key_compare key_comp() const { return tree_.comp.comp; }
+
+  value_compare value_comp() const { return tree_.comp; }
+
+  tree_statistics tree_stats() const { return tree_.tree_stats(); }
+
+  void swap(BinarySearchTreeMap& other) { tree_.swap(other.tree_); }
+
+  template <typename... Args>
+  std::pair<iterator<>, bool> try_emplace(const Key& key, Args&&... args) {
+    node_type* parent;
+    bool to_left;
+    node_type* node = tree_.locate_(key, parent, to_left);
+    if (node != nullptr) {
+      return std::make_pair(wrap_<inorder_tag>(node), false);
+    }
+    node = tree_.link_new_(parent, to_left, std::piecewise_construct,
+                           std::forward_as_tuple(key),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(wrap_<inorder_tag>(node), true);
+  }
+
+  template <typename... Args>
+  std::pair<iterator<>, bool> try_emplace(Key&& key, Args&&... args) {
+    node_type* parent;
+    bool to_left;
+    node_type* node = tree_.locate_(key, parent, to_left);
+    if (node != nullptr) {
+      return std::make_pair(wrap_<inorder_tag>(node), false);
+    }
+    node = tree_.link_new_(parent, to_left, std::piecewise_construct,
+                           std::forward_as_tuple(std::move(key)),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(wrap_<inorder_tag>(node), true);
+  }
+
+  template <typename M>
+  std::pair<iterator<>, bool> insert_or_assign(const Key& key, M&& obj) {
+    return assign_(key, std::forward<M>(obj));
+  }
+
+  template <typename M>
+  std::pair<iterator<>, bool> insert_or_assign(Key&& key, M&& obj) {
+    return assign_(std::move(key), std::forward<M>(obj));
+  }
+
+  std::pair<iterator<>, bool> insert(const value_type& value) {
+    return try_emplace(value.first, value.second);
+  }
+
+  template <typename It>
+  void insert(It it1, It it2) {
+    for (auto it = it1; it != it2; ++it) {
+      insert(*it);
+    }
+  }
+
+  Value& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+  Value& operator[](Key&& key) {
+    return try_emplace(std::move(key)).first->second;
+  }
+
+  Value& at(const Key& key) {
+    node_type* node = find_node_(key);
+    if (node == nullptr) {
+      throw std::out_of_range("bst: key not found");
+    }
+    return node->key.second;
+  }
+
+  const Value& at(const Key& key) const {
+    node_type* node = find_node_(key);
+    if (node == nullptr) {
+      throw std::out_of_range("bst: key not found");
+    }
+    return node->key.second;
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> find(const Key& key) {
+    node_type* node = find_node_(key);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return wrap_<traversal_type>(node);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> find(const Key& key) const {
+    node_type* node = find_node_(key);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return tree_.template make_iterator_<traversal_type>(node);
+  }
+
+  bool contains(const Key& key) const { return find_node_(key) != nullptr; }
+
+  size_type count(const Key& key) const { return contains(key) ? 1 : 0; }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> lower_bound(const Key& key) {
+    node_type* last;
+    node_type* node = tree_.lower_bound_node_(key, last);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return wrap_<traversal_type>(node);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> lower_bound(const Key& key) const {
+    node_type* last;
+    node_type* node = tree_.lower_bound_node_(key, last);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return tree_.template make_iterator_<traversal_type>(node);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> upper_bound(const Key& key) {
+    node_type* node = tree_.upper_bound_node_(key);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return wrap_<traversal_type>(node);
+  }
+
+  template <typename traversal_type = inorder_tag>
+  const_iterator<traversal_type> upper_bound(const Key& key) const {
+    node_type* node = tree_.upper_bound_node_(key);
+    if (node == nullptr) {
+      return end<traversal_type>();
+    }
+    return tree_.template make_iterator_<traversal_type>(node);
+  }
+
+  std::pair<iterator<>, iterator<>> equal_range(const Key& key) {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  std::pair<const_iterator<>, const_iterator<>> equal_range(
+      const Key& key) const {
+    return std::make_pair(lower_bound(key), upper_bound(key));
+  }
+
+  template <typename traversal_type = inorder_tag>
+  iterator<traversal_type> erase(iterator<traversal_type> it) {
+    return tree_.template erase<traversal_type>(it.it);
+  }
+
+  size_type erase(const Key& key) {
+    node_type* node = find_node_(key);
+    if (node == nullptr) {
+      return 0;
+    }
+    tree_.erase(tree_.template make_iterator_<inorder_tag>(node));
+    return 1;
+  }
+
+  void clear() { tree_.clear(); }
+
+ private:
+  template <typename K, typename M>
+  std::pair<iterator<>, bool> assign_(K&& key, M&& obj) {
+    node_type* parent;
+    bool to_left;
+    node_type* node = tree_.locate_(key, parent, to_left);
+    if (node != nullptr) {
+      node->key.second = std::forward<M>(obj);
+      return std::make_pair(wrap_<inorder_tag>(node), false);
+    }
+    node = tree_.link_new_(parent, to_left, std::forward<K>(key),
+                           std::forward<M>(obj));
+    return std::make_pair(wrap_<inorder_tag>(node), true);
+  }
+
+  node_type* find_node_(const Key& key) const {
+    node_type* parent;
+    bool to_left;
+    return tree_.locate_(key, parent, to_left);
+  }
+};
+
+#ifdef BST_HAS_MMAP
+
+template <typename T, typename Compare = std::less<T>>
+  requires std::is_trivially_copyable_v<T>
+class MappedBinarySearchTree {
+ public:
+  using value_type = T;
+  using key_type = T;
+  using const_reference = const T&;
+  using const_iterator = const T*;
+  using size_type = size_t;
+  using key_compare = Compare;
+
+ private:
+  static_assert(alignof(T) <= sizeof(bst_file_header));
+
+  void* map_;
+  size_type bytes_;
+  const T* data_;
+  size_type size_;
+  Compare comp;
+
+ public:
+  explicit MappedBinarySearchTree(const char* path, Compare comp = Compare())
+      : map_(MAP_FAILED), bytes_(0), data_(nullptr), size_(0), comp(comp) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("bst: cannot open file");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 ||
+        static_cast<size_type>(info.st_size) < sizeof(bst_file_header)) {
+      ::close(fd);
+      throw std::runtime_error("bst: truncated header");
+    }
+    bytes_ = info.st_size;
+    map_ = ::mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map_ == MAP_FAILED) {
+      throw std::runtime_error("bst: mmap failed");
+    }
+    const bst_file_header* header = static_cast<const bst_file_header*>(map_);
+    try {
+      header->check<T>();
+      size_type payload = bytes_ - sizeof(bst_file_header);
+      if (header->count > payload / sizeof(T) ||
+          payload != header->count * sizeof(T)) {
+        throw std::runtime_error("bst: truncated payload");
+      }
+      data_ = reinterpret_cast<const T*>(static_cast<const char*>(map_) +
+                                         sizeof(bst_file_header));
+      size_ = header->count;
+      if (bst_file_header::hash(data_, size_ * sizeof(T)) !=
+          header->checksum) {
+        throw std::runtime_error("bst: checksum mismatch");
+      }
+    } catch (...) {
+      ::munmap(map_, bytes_);
+      throw;
+    }
+  }
+
+  MappedBinarySearchTree(const MappedBinarySearchTree&) = delete;
+  MappedBinarySearchTree& operator=(const MappedBinarySearchTree&) = delete;
+
+  ~MappedBinarySearchTree() { ::munmap(map_, bytes_); }
+
+  const_iterator begin() const { return data_; }
+
+  const_iterator end() const { return data_ + size_; }
+
+  size_type size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  key_compare key_comp() const { return comp; }
+
+  const_iterator lower_bound(const_reference value) const {
+    return std::lower_bound(begin(), end(), value, comp);
+  }
+
+  const_iterator upper_bound(const_reference value) const {
+    return std::upper_bound(begin(), end(), value, comp);
+  }
+
+  const_iterator find(const_reference value) const {
+    const_iterator it = lower_bound(value);
+    if (it == end() || comp(value, *it)) {
+      return end();
+    }
+    return it;
+  }
+
+  bool contains(const_reference value) const { return find(value) != end(); }
+
+  size_type count(const_reference value) const {
+    return upper_bound(value) - lower_bound(value);
+  }
+};
+
+#endif
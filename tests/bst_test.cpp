@@ -1,7 +1,19 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
 #include <lib/BST.cpp>
+#include <limits>
+#include <memory>
+#include <random>
+#include <ranges>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 TEST(BstTestSuite, InorderTraversalTest) {
@@ -204,6 +216,8 @@ TEST(BstTestSuite, TrivialConstructorTest) {
   ASSERT_EQ(bst1, bst2);
   bst1.erase(7);
   bst1.insert(7);
+  ASSERT_TRUE(bst1 == bst2);
+  bst1.erase(7);
   ASSERT_FALSE(bst1 == bst2);
   bst2 = bst2;
   bst1 = bst2;
@@ -223,4 +237,742 @@ TEST(BstTestSuite, ConstructorTest) {
   ASSERT_TRUE(bst.contains(1));
   ASSERT_TRUE(bst.contains(7));
   ASSERT_TRUE(bst.contains(10));
-}
\ No newline at end of file
+}
+
+TEST(BstTestSuite, ParallelReduceTest) {
+  std::vector<int> v(50000);
+  for (int i = 0; i < static_cast<int>(v.size()); ++i) {
+    v[i] = i;
+  }
+  std::shuffle(v.begin(), v.end(), std::mt19937(42));
+  BinarySearchTree<int> bst(v.begin(), v.end());
+  long long sum = bst.parallel_transform_reduce(
+      0LL, std::plus<long long>{}, [](int x) -> long long { return x; });
+  ASSERT_EQ(sum, 50000LL * 49999 / 2);
+  ASSERT_EQ(bst.parallel_reduce(0, [](int a, int b) { return std::max(a, b); }),
+            49999);
+  ASSERT_EQ(bst.parallel_count_if([](int x) { return x % 3 == 0; }), 16667);
+  std::atomic<long long> visited = 0;
+  bst.parallel_for_each([&visited](int x) { visited += x; });
+  ASSERT_EQ(visited, sum);
+}
+
+template <typename traversal_type>
+void CheckParallelOrder(const BinarySearchTree<int>& bst) {
+  auto concat = [](std::vector<int> a, std::vector<int> b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+  };
+  auto result = bst.parallel_transform_reduce<traversal_type>(
+      std::vector<int>{}, concat, [](int x) { return std::vector<int>{x}; });
+  std::vector<int> expected;
+  for (auto it = bst.begin<traversal_type>(); it != bst.end<traversal_type>();
+       ++it) {
+    expected.push_back(*it);
+  }
+  ASSERT_EQ(result, expected);
+}
+
+TEST(BstTestSuite, ParallelOrderTest) {
+  std::vector<int> v(30000);
+  for (int i = 0; i < static_cast<int>(v.size()); ++i) {
+    v[i] = i;
+  }
+  std::shuffle(v.begin(), v.end(), std::mt19937(7));
+  BinarySearchTree<int> bst(v.begin(), v.end());
+  CheckParallelOrder<inorder_tag>(bst);
+  CheckParallelOrder<preorder_tag>(bst);
+  CheckParallelOrder<postorder_tag>(bst);
+  BinarySearchTree<int> small(
+      std::initializer_list<int>{4, 2, 6, 10, 1, 7, 13, 5, 3});
+  CheckParallelOrder<inorder_tag>(small);
+  CheckParallelOrder<preorder_tag>(small);
+  CheckParallelOrder<postorder_tag>(small);
+  BinarySearchTree<int> empty;
+  ASSERT_EQ(empty.parallel_count_if([](int) { return true; }), 0);
+}
+
+TEST(BstTestSuite, BulkLoadTest) {
+  std::vector<int> v;
+  for (int i = 0; i < 100000; ++i) {
+    v.push_back(i % 60000);
+  }
+  std::shuffle(v.begin(), v.end(), std::mt19937(1));
+  BinarySearchTree<int> bst(std::initializer_list<int>{-5, -3});
+  bst.bulk_load(v.begin(), v.end());
+  ASSERT_EQ(bst.size(), 60000);
+  ASSERT_FALSE(bst.contains(-5));
+  ASSERT_EQ(*bst.begin<preorder_tag>(), 30000);
+  int expected = 0;
+  for (auto it = bst.begin(); it != bst.end(); ++it) {
+    ASSERT_EQ(*it, expected);
+    ++expected;
+  }
+  size_t postorder = 0;
+  for (auto it = bst.begin<postorder_tag>(); it != bst.end<postorder_tag>();
+       ++it) {
+    ++postorder;
+  }
+  ASSERT_EQ(postorder, bst.size());
+  bst.erase(0);
+  bst.insert(-1);
+  ASSERT_EQ(*bst.begin(), -1);
+  std::vector<int> none;
+  bst.bulk_load(none.begin(), none.end());
+  ASSERT_TRUE(bst.empty());
+
+  std::istringstream in("pear fig apple kiwi fig plum cherry date lime");
+  BinarySearchTree<std::string> words;
+  words.bulk_load(std::istream_iterator<std::string>(in),
+                  std::istream_iterator<std::string>());
+  ASSERT_EQ(words.size(), 8);
+  ASSERT_EQ(*words.begin(), "apple");
+  std::istringstream more("fig grape banana");
+  ASSERT_EQ(words.insert_batch(std::istream_iterator<std::string>(more),
+                               std::istream_iterator<std::string>()),
+            2);
+  ASSERT_TRUE(words.contains("banana"));
+}
+
+struct FragileValue {
+  static inline int live = 0;
+  static inline int moves_left = -1;
+
+  int value;
+
+  FragileValue(int value) : value(value) { ++live; }
+  FragileValue(const FragileValue& other) : value(other.value) { ++live; }
+  FragileValue(FragileValue&& other) : value(other.value) {
+    if (moves_left == 0) {
+      throw std::runtime_error("move");
+    }
+    if (moves_left > 0) {
+      --moves_left;
+    }
+    ++live;
+  }
+  FragileValue& operator=(const FragileValue&) = default;
+  ~FragileValue() { --live; }
+
+  bool operator<(const FragileValue& other) const {
+    return value < other.value;
+  }
+};
+
+TEST(BstTestSuite, BuildExceptionTest) {
+  std::vector<FragileValue> input;
+  for (int i = 0; i < 200; ++i) {
+    input.emplace_back((i * 37) % 200);
+  }
+  BinarySearchTree<FragileValue> bst;
+  bst.insert(FragileValue(-1));
+  int before = FragileValue::live;
+  FragileValue::moves_left = 1 << 30;
+  BinarySearchTree<FragileValue>().bulk_load(input.begin(), input.end());
+  int moves = (1 << 30) - FragileValue::moves_left;
+  for (int budget = 0; budget < moves; budget += 7) {
+    FragileValue::moves_left = budget;
+    ASSERT_THROW(bst.bulk_load(input.begin(), input.end()),
+                 std::runtime_error);
+    FragileValue::moves_left = -1;
+    ASSERT_EQ(FragileValue::live, before);
+    ASSERT_EQ(bst.size(), 1);
+    ASSERT_EQ(bst.begin()->value, -1);
+  }
+
+  std::vector<FragileValue> batch;
+  for (int i = 0; i < 64; ++i) {
+    batch.emplace_back(i % 2 == 0 ? -2 - i : 1000 + i);
+  }
+  FragileValue::moves_left = 1 << 30;
+  {
+    BinarySearchTree<FragileValue> sample;
+    sample.insert(FragileValue(-1));
+    sample.insert_batch(batch.begin(), batch.end());
+  }
+  moves = (1 << 30) - FragileValue::moves_left;
+  for (int budget = 0; budget < moves; budget += 3) {
+    BinarySearchTree<FragileValue> target;
+    target.insert(FragileValue(-1));
+    FragileValue::moves_left = budget;
+    ASSERT_THROW(target.insert_batch(batch.begin(), batch.end()),
+                 std::runtime_error);
+    FragileValue::moves_left = -1;
+    size_t walked = 0;
+    int previous = std::numeric_limits<int>::min();
+    for (auto it = target.begin(); it != target.end(); ++it) {
+      ASSERT_LT(previous, it->value);
+      previous = it->value;
+      ++walked;
+    }
+    ASSERT_EQ(walked, target.size());
+    size_t reachable = 0;
+    for (auto it = target.begin<preorder_tag>();
+         it != target.end<preorder_tag>(); ++it) {
+      ++reachable;
+    }
+    ASSERT_EQ(reachable, target.size());
+  }
+}
+
+TEST(BstTestSuite, BatchTest) {
+  BinarySearchTree<int> bst(std::initializer_list<int>{50, 20, 80, 10, 30});
+  std::vector<int> batch{5, 30, 85, 25, 90, 5, 60, 15, 35};
+  ASSERT_EQ(bst.insert_batch(batch.begin(), batch.end()), 7);
+  ASSERT_EQ(bst.size(), 12);
+  std::vector<int> inorder{5, 10, 15, 20, 25, 30, 35, 50, 60, 80, 85, 90};
+  auto it1 = inorder.begin();
+  for (auto it2 = bst.begin(); it2 != bst.end(); ++it2, ++it1) {
+    ASSERT_EQ(*it1, *it2);
+  }
+  ASSERT_EQ(*bst.begin<preorder_tag>(), 50);
+  ASSERT_EQ(*bst.begin<postorder_tag>(), 5);
+  ASSERT_EQ(*(--bst.end<postorder_tag>()), 50);
+  std::vector<int> removal{50, 5, 7, 30, 90, 50, 20};
+  ASSERT_EQ(bst.erase_batch(removal.begin(), removal.end()), 5);
+  ASSERT_EQ(bst.size(), 7);
+  std::vector<int> rest{10, 15, 25, 35, 60, 80, 85};
+  it1 = rest.begin();
+  for (auto it2 = bst.begin(); it2 != bst.end(); ++it2, ++it1) {
+    ASSERT_EQ(*it1, *it2);
+  }
+  size_t postorder = 0;
+  for (auto it = bst.end<postorder_tag>(); it != bst.begin<postorder_tag>();
+       --it) {
+    ++postorder;
+  }
+  ASSERT_EQ(postorder, bst.size());
+  ASSERT_EQ(bst.erase_batch(rest.begin(), rest.end()), 7);
+  ASSERT_TRUE(bst.empty());
+  ASSERT_EQ(bst.insert_batch(rest.begin(), rest.end()), 7);
+  ASSERT_EQ(*bst.begin<preorder_tag>(), 35);
+}
+
+TEST(BstTestSuite, EraseRangeTest) {
+  BinarySearchTree<int> bst(
+      std::initializer_list<int>{40, 20, 60, 10, 30, 50, 70, 25, 35, 55});
+  ASSERT_EQ(bst.erase_range(22, 52), 5);
+  ASSERT_EQ(bst.size(), 5);
+  std::vector<int> rest{10, 20, 55, 60, 70};
+  auto it1 = rest.begin();
+  for (auto it2 = bst.begin(); it2 != bst.end(); ++it2, ++it1) {
+    ASSERT_EQ(*it1, *it2);
+  }
+  size_t postorder = 0;
+  for (auto it = bst.begin<postorder_tag>(); it != bst.end<postorder_tag>();
+       ++it) {
+    ++postorder;
+  }
+  ASSERT_EQ(postorder, bst.size());
+  ASSERT_EQ(bst.erase_range(60, 60), 0);
+  ASSERT_EQ(bst.erase_range(80, 10), 0);
+  auto it = bst.erase(bst.begin(), bst.find(60));
+  ASSERT_EQ(*it, 60);
+  ASSERT_EQ(*bst.begin(), 60);
+  ASSERT_EQ(bst.size(), 2);
+  ASSERT_EQ(bst.erase_range(0, 1000), 2);
+  ASSERT_TRUE(bst.empty());
+  ASSERT_EQ(bst.erase_range(0, 1000), 0);
+}
+
+TEST(BstTestSuite, SerializeTest) {
+  BinarySearchTree<int> bst(
+      std::initializer_list<int>{40, 20, 60, 10, 30, 50, 70, 25});
+  std::stringstream stream;
+  bst.serialize(stream);
+  BinarySearchTree<int> loaded(std::initializer_list<int>{1, 2});
+  loaded.deserialize(stream);
+  ASSERT_EQ(loaded.size(), bst.size());
+  auto it1 = bst.begin();
+  for (auto it2 = loaded.begin(); it2 != loaded.end(); ++it2, ++it1) {
+    ASSERT_EQ(*it1, *it2);
+  }
+  ASSERT_EQ(*loaded.begin<preorder_tag>(), 40);
+  std::string bytes = stream.str();
+  bytes.back() ^= 1;
+  std::stringstream corrupted(bytes);
+  ASSERT_THROW(loaded.deserialize(corrupted), std::runtime_error);
+  ASSERT_EQ(loaded.size(), bst.size());
+  std::stringstream truncated(bytes.substr(0, 10));
+  ASSERT_THROW(loaded.deserialize(truncated), std::runtime_error);
+  std::stringstream short_payload(bytes.substr(0, bytes.size() - 4));
+  ASSERT_THROW(loaded.deserialize(short_payload), std::runtime_error);
+
+  int payload[2] = {1, 2};
+  bst_file_header forged = bst_file_header::make<int>(
+      (1ULL << 62) + 2, bst_file_header::hash(payload, sizeof(payload)));
+  std::stringstream oversized;
+  oversized.write(reinterpret_cast<const char*>(&forged), sizeof(forged));
+  oversized.write(reinterpret_cast<const char*>(payload), sizeof(payload));
+  ASSERT_THROW(loaded.deserialize(oversized), std::runtime_error);
+  ASSERT_EQ(loaded.size(), bst.size());
+}
+
+TEST(BstTestSuite, MappedViewTest) {
+  BinarySearchTree<int> bst(
+      std::initializer_list<int>{40, 20, 60, 10, 30, 50, 70, 25});
+  std::string path = testing::TempDir() + "bst_mapped_view.bin";
+  {
+    std::ofstream out(path, std::ios::binary);
+    bst.serialize(out);
+  }
+  MappedBinarySearchTree<int> view(path.c_str());
+  ASSERT_EQ(view.size(), 8);
+  ASSERT_TRUE(view.contains(25));
+  ASSERT_FALSE(view.contains(26));
+  ASSERT_EQ(view.find(26), view.end());
+  ASSERT_EQ(*view.lower_bound(26), 30);
+  ASSERT_EQ(*view.upper_bound(30), 40);
+  ASSERT_EQ(view.lower_bound(71), view.end());
+  ASSERT_THROW(MappedBinarySearchTree<long long>(path.c_str()),
+               std::runtime_error);
+
+  int payload[2] = {1, 2};
+  bst_file_header forged = bst_file_header::make<int>(
+      (1ULL << 62) + 2, bst_file_header::hash(payload, sizeof(payload)));
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&forged), sizeof(forged));
+    out.write(reinterpret_cast<const char*>(payload), sizeof(payload));
+  }
+  ASSERT_THROW(MappedBinarySearchTree<int>(path.c_str()), std::runtime_error);
+  std::remove(path.c_str());
+}
+
+TEST(BstTestSuite, TreeStatsTest) {
+  using CountingTree =
+      BinarySearchTree<int, std::less<int>, std::allocator<int>,
+                       counting_stats>;
+  CountingTree chain;
+  for (int i = 0; i < 100; ++i) {
+    chain.insert(i);
+  }
+  tree_statistics chain_stats = chain.tree_stats();
+  ASSERT_EQ(chain_stats.size, 100);
+  ASSERT_EQ(chain_stats.height, 100);
+  ASSERT_EQ(chain_stats.depth_histogram[0], 1);
+  ASSERT_EQ(chain_stats.depth_histogram[tree_statistics::depth_buckets - 1],
+            100 - tree_statistics::depth_buckets + 1);
+  ASSERT_DOUBLE_EQ(chain_stats.average_path_length, 50.5);
+  ASSERT_EQ(chain_stats.allocations, 100);
+
+  std::vector<int> v(127);
+  for (int i = 0; i < 127; ++i) {
+    v[i] = i;
+  }
+  CountingTree balanced;
+  balanced.bulk_load(v.begin(), v.end());
+  tree_statistics stats = balanced.tree_stats();
+  ASSERT_EQ(stats.height, 7);
+  for (size_t depth = 0; depth < 7; ++depth) {
+    ASSERT_EQ(stats.depth_histogram[depth], size_t{1} << depth);
+  }
+  ASSERT_EQ(stats.allocations, 127);
+  ASSERT_GE(stats.bytes, 127 * sizeof(int));
+  size_t visited = stats.nodes_visited;
+  balanced.find(0);
+  ASSERT_EQ(balanced.tree_stats().nodes_visited - visited, 7);
+  balanced.erase(0);
+  ASSERT_EQ(balanced.tree_stats().deallocations, 1);
+  size_t climbs = balanced.tree_stats().parent_climbs;
+  for (auto it = balanced.begin(); it != balanced.end(); ++it) {
+  }
+  ASSERT_GT(balanced.tree_stats().parent_climbs, climbs);
+  ASSERT_EQ(chain.tree_stats().parent_climbs, 0);
+
+  const CountingTree& shared = balanced;
+  size_t compared = shared.tree_stats().comparisons;
+  shared.find(126);
+  size_t per_find = shared.tree_stats().comparisons - compared;
+  compared += per_find;
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&shared]() {
+      for (int i = 0; i < 1000; ++i) {
+        shared.find(126);
+      }
+    });
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  ASSERT_EQ(shared.tree_stats().comparisons - compared, 4 * 1000 * per_find);
+
+  BinarySearchTree<int> plain(v.begin(), v.end());
+  ASSERT_EQ(plain.tree_stats().comparisons, 0);
+  ASSERT_EQ(plain.tree_stats().height, 127);
+  ASSERT_EQ(sizeof(CountingTree) - sizeof(plain), sizeof(counting_stats));
+}
+
+TEST(BstTestSuite, SplaySequentialAccessTest) {
+  const int n = 100000;
+  std::vector<int> v(n);
+  for (int i = 0; i < n; ++i) {
+    v[i] = i;
+  }
+  SplayTree<int> splay;
+  splay.bulk_load(v.begin(), v.end());
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < n; ++i) {
+      ASSERT_EQ(*splay.find(i), i);
+    }
+  }
+  SplayTree<int> ascending;
+  for (int i = 0; i < n; ++i) {
+    ascending.insert(i);
+  }
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+
+  SplayTree<int> small(std::initializer_list<int>{5, 3, 8});
+  small.swap(splay);
+  for (SplayTree<int>* tree : {&splay, &small, &ascending}) {
+    std::vector<int> postorder;
+    for (auto it = tree->begin<postorder_tag>();
+         it != tree->end<postorder_tag>(); ++it) {
+      postorder.push_back(*it);
+    }
+    ASSERT_EQ(postorder.size(), tree->size());
+    ASSERT_EQ(postorder.back(), *tree->begin<preorder_tag>());
+    size_t reversed = 0;
+    for (auto it = tree->end<postorder_tag>();
+         it != tree->begin<postorder_tag>(); --it) {
+      ++reversed;
+    }
+    ASSERT_EQ(reversed, tree->size());
+  }
+}
+
+TEST(BstTestSuite, SplayTest) {
+  using CountingSplayTree =
+      SplayTree<int, std::less<int>, std::allocator<int>, counting_stats>;
+  using CountingTree =
+      BinarySearchTree<int, std::less<int>, std::allocator<int>,
+                       counting_stats>;
+  std::vector<int> v(1023);
+  for (int i = 0; i < 1023; ++i) {
+    v[i] = i;
+  }
+  CountingSplayTree splay;
+  splay.bulk_load(v.begin(), v.end());
+  CountingTree balanced;
+  balanced.bulk_load(v.begin(), v.end());
+  std::mt19937 gen(11);
+  size_t splay_visits = splay.tree_stats().nodes_visited;
+  size_t balanced_visits = balanced.tree_stats().nodes_visited;
+  for (int i = 0; i < 10000; ++i) {
+    int key = gen() % 10 == 0 ? static_cast<int>(gen() % 1023)
+                              : 3 + static_cast<int>(gen() % 8) * 97;
+    ASSERT_EQ(*splay.find(key), key);
+    ASSERT_EQ(*balanced.find(key), key);
+  }
+  splay_visits = splay.tree_stats().nodes_visited - splay_visits;
+  balanced_visits = balanced.tree_stats().nodes_visited - balanced_visits;
+  ASSERT_LT(splay_visits, balanced_visits);
+
+  ASSERT_EQ(*splay.lower_bound(500), 500);
+  ASSERT_EQ(*splay.begin<preorder_tag>(), 500);
+  ASSERT_EQ(splay.lower_bound(5000), splay.end());
+  const CountingSplayTree& view = splay;
+  ASSERT_EQ(*view.find(700), 700);
+  ASSERT_NE(*splay.begin<preorder_tag>(), 700);
+
+  ASSERT_EQ(splay.size(), 1023);
+  int expected = 0;
+  for (auto it = splay.begin(); it != splay.end(); ++it, ++expected) {
+    ASSERT_EQ(*it, expected);
+  }
+  size_t count = 0;
+  for (auto it = splay.begin<postorder_tag>();
+       it != splay.end<postorder_tag>(); ++it) {
+    ++count;
+  }
+  ASSERT_EQ(count, splay.size());
+  count = 0;
+  for (auto it = splay.end<preorder_tag>(); it != splay.begin<preorder_tag>();
+       --it) {
+    ++count;
+  }
+  ASSERT_EQ(count, splay.size());
+  splay.insert(-1);
+  ASSERT_EQ(*splay.begin<preorder_tag>(), -1);
+  ASSERT_EQ(*splay.begin(), -1);
+}
+
+TEST(BstTestSuite, EraseLeftmostTest) {
+  BinarySearchTree<int> bst(std::initializer_list<int>{5, 3, 4, 8});
+  bst.erase(3);
+  ASSERT_EQ(*bst.begin(), 4);
+  BinarySearchTree<int> chain(std::initializer_list<int>{1, 2, 3});
+  chain.erase(1);
+  ASSERT_EQ(*chain.begin(), 2);
+  ASSERT_EQ(*(--chain.end()), 3);
+}
+
+TEST(BstTestSuite, MultiTreeTest) {
+  BinarySearchMultiTree<int> bst(
+      std::initializer_list<int>{5, 3, 8, 5, 1, 5, 8, 3, 9});
+  ASSERT_EQ(bst.size(), 9);
+  auto it = bst.insert(5);
+  ASSERT_EQ(*it, 5);
+  ASSERT_EQ(bst.count(5), 4);
+  ASSERT_EQ(bst.count(8), 2);
+  ASSERT_EQ(bst.count(7), 0);
+  std::vector<int> inorder{1, 3, 3, 5, 5, 5, 5, 8, 8, 9};
+  auto it1 = inorder.begin();
+  for (auto it2 = bst.begin(); it2 != bst.end(); ++it2, ++it1) {
+    ASSERT_EQ(*it1, *it2);
+  }
+  size_t count = 0;
+  for (auto it2 = bst.begin<preorder_tag>(); it2 != bst.end<preorder_tag>();
+       ++it2) {
+    ++count;
+  }
+  ASSERT_EQ(count, bst.size());
+  count = 0;
+  for (auto it2 = bst.end<postorder_tag>(); it2 != bst.begin<postorder_tag>();
+       --it2) {
+    ++count;
+  }
+  ASSERT_EQ(count, bst.size());
+
+  auto range = bst.equal_range(5);
+  count = 0;
+  for (auto it2 = range.first; it2 != range.second; ++it2) {
+    ASSERT_EQ(*it2, 5);
+    ++count;
+  }
+  ASSERT_EQ(count, 4);
+  ASSERT_EQ(*range.second, 8);
+  ASSERT_EQ(*bst.find(5), 5);
+  ASSERT_EQ(*(--bst.find(5)), 3);
+
+  auto second_five = ++bst.find(5);
+  bst.erase(bst.find(3), second_five);
+  ASSERT_EQ(bst.count(3), 0);
+  ASSERT_EQ(bst.count(5), 3);
+  ASSERT_EQ(bst.erase(5), 3);
+  ASSERT_EQ(bst.erase(5), 0);
+  ASSERT_EQ(bst.size(), 4);
+
+  std::vector<int> batch{8, 2, 2, 7};
+  ASSERT_EQ(bst.insert_batch(batch.begin(), batch.end()), 4);
+  ASSERT_EQ(bst.count(2), 2);
+  ASSERT_EQ(bst.count(8), 3);
+  std::vector<int> removal{8, 2, 4};
+  ASSERT_EQ(bst.erase_batch(removal.begin(), removal.end()), 5);
+  ASSERT_EQ(bst.size(), 3);
+
+  std::vector<int> load{4, 4, 1, 4, 2};
+  bst.bulk_load(load.begin(), load.end());
+  ASSERT_EQ(bst.size(), 5);
+  ASSERT_EQ(bst.count(4), 3);
+
+  BinarySearchMultiTree<int> tagged;
+  auto root = tagged.insert<preorder_tag>(5);
+  ASSERT_EQ(root, tagged.begin<preorder_tag>());
+  auto leaf = tagged.insert<postorder_tag>(5);
+  ASSERT_EQ(leaf, tagged.begin<postorder_tag>());
+  ASSERT_EQ(*++leaf, 5);
+  ASSERT_EQ(++leaf, tagged.end<postorder_tag>());
+
+  std::vector<int> runs{5, 5, 5, 5, 5, 5, 5, 3, 9, 9};
+  bst.bulk_load(runs.begin(), runs.end());
+  std::vector<int> drop{9, 5, 5, 4};
+  ASSERT_EQ(bst.erase_batch(drop.begin(), drop.end()), 9);
+  ASSERT_EQ(bst.size(), 1);
+  ASSERT_EQ(*bst.begin(), 3);
+}
+
+TEST(BstTestSuite, MapTest) {
+  BinarySearchTreeMap<std::string, int> counters;
+  for (const char* word : {"b", "a", "c", "a", "b", "a"}) {
+    ++counters[word];
+  }
+  ASSERT_EQ(counters.size(), 3);
+  ASSERT_EQ(counters["a"], 3);
+  ASSERT_EQ(counters.at("b"), 2);
+  ASSERT_THROW(counters.at("z"), std::out_of_range);
+  auto t = counters.try_emplace("a", 100);
+  ASSERT_FALSE(t.second);
+  ASSERT_EQ(t.first->second, 3);
+  auto u = counters.insert_or_assign("a", 100);
+  ASSERT_FALSE(u.second);
+  ASSERT_EQ(counters["a"], 100);
+  ASSERT_TRUE(counters.insert_or_assign("d", 4).second);
+  ASSERT_EQ(counters.size(), 4);
+
+  for (auto it = counters.begin(); it != counters.end(); ++it) {
+    it->second *= 2;
+  }
+  std::vector<std::string> keys;
+  std::vector<int> values;
+  for (auto it = counters.begin(); it != counters.end(); ++it) {
+    keys.push_back(it->first);
+    values.push_back(it->second);
+  }
+  ASSERT_EQ(keys, (std::vector<std::string>{"a", "b", "c", "d"}));
+  ASSERT_EQ(values, (std::vector<int>{200, 4, 2, 8}));
+  auto pre = counters.begin<preorder_tag>();
+  ASSERT_EQ(pre->first, "b");
+  (*pre).second = -1;
+  ASSERT_EQ(counters["b"], -1);
+
+  ASSERT_EQ(counters.lower_bound("bb")->first, "c");
+  ASSERT_EQ(counters.upper_bound("c")->first, "d");
+  ASSERT_EQ(counters.find("zz"), counters.end());
+  ASSERT_EQ(counters.erase("c"), 1);
+  ASSERT_EQ(counters.erase("c"), 0);
+  ASSERT_FALSE(counters.contains("c"));
+  auto next = counters.erase(counters.find("a"));
+  ASSERT_EQ(next->first, "b");
+  const auto& view = counters;
+  ASSERT_EQ(view.find("d")->second, 8);
+  ASSERT_EQ(view.count("d"), 1);
+  ASSERT_EQ(view.lower_bound("c")->first, "d");
+  ASSERT_EQ(view.upper_bound("d"), view.end());
+  auto range = view.equal_range("b");
+  ASSERT_EQ(range.first->first, "b");
+  ASSERT_EQ(range.second->first, "d");
+  auto missing = counters.equal_range("c");
+  ASSERT_EQ(missing.first, missing.second);
+
+  std::string key = "e";
+  ASSERT_TRUE(counters.insert_or_assign(std::move(key), 5).second);
+  ASSERT_EQ(counters.at("e"), 5);
+  ASSERT_TRUE(counters.key_comp()("a", "b"));
+  ASSERT_FALSE(counters.value_comp()(*counters.find("e"), *counters.find("b")));
+  ASSERT_EQ(sizeof(counters), sizeof(BinarySearchTree<int>));
+}
+
+TEST(BstTestSuite, MapInPlaceTest) {
+  BinarySearchTreeMap<int, std::unique_ptr<int>> map;
+  auto r = map.try_emplace(5, std::make_unique<int>(50));
+  ASSERT_TRUE(r.second);
+  ASSERT_EQ(*r.first->second, 50);
+  map.try_emplace(3, std::make_unique<int>(30));
+  map[7] = std::make_unique<int>(70);
+  map.insert_or_assign(3, std::make_unique<int>(31));
+  ASSERT_EQ(*map.at(3), 31);
+  ASSERT_EQ(*map[7], 70);
+  ASSERT_EQ(map.size(), 3);
+}
+
+TEST(BstTestSuite, ComparisonTest) {
+  BinarySearchTree<int> a(std::initializer_list<int>{1, 2, 3, 4});
+  BinarySearchTree<int> b(std::initializer_list<int>{3, 1, 4, 2});
+  BinarySearchTree<int> c(std::initializer_list<int>{1, 2, 5});
+  BinarySearchTree<int> d(std::initializer_list<int>{1, 2, 3});
+  BinarySearchTree<int> empty;
+  ASSERT_TRUE(a == b);
+  ASSERT_FALSE(a != b);
+  ASSERT_TRUE(a == a);
+  ASSERT_FALSE(a == c);
+  ASSERT_TRUE((a <=> b) == 0);
+  ASSERT_TRUE(a < c);
+  ASSERT_TRUE(d < a);
+  ASSERT_TRUE(c > d);
+  ASSERT_TRUE(empty < d);
+  ASSERT_TRUE(empty == BinarySearchTree<int>());
+  ASSERT_TRUE((empty <=> empty) == 0);
+  BinarySearchTree<std::string> s1(std::initializer_list<std::string>{"b", "a"});
+  BinarySearchTree<std::string> s2(std::initializer_list<std::string>{"a", "c"});
+  ASSERT_TRUE(s1 < s2);
+  ASSERT_TRUE(s1 != s2);
+}
+
+static_assert(std::bidirectional_iterator<BinarySearchTree<int>::iterator<>>);
+static_assert(std::bidirectional_iterator<
+              BinarySearchTree<int>::iterator<preorder_tag>>);
+static_assert(std::bidirectional_iterator<
+              BinarySearchTreeMap<int, int>::iterator<postorder_tag>>);
+static_assert(std::ranges::bidirectional_range<
+              decltype(std::declval<BinarySearchTree<int>&>().view())>);
+static_assert(std::ranges::input_range<
+              decltype(std::declval<BinarySearchTree<int>&>().level_order())>);
+static_assert(std::ranges::input_range<bst_generator<int>>);
+
+TEST(BstTestSuite, RangesTest) {
+  BinarySearchTree<int> bst(
+      std::initializer_list<int>{4, 2, 6, 10, 1, 7, 13, 5, 3});
+  std::vector<int> even;
+  for (int x : bst.view<preorder_tag>() |
+                   std::views::filter([](int x) { return x % 2 == 0; })) {
+    even.push_back(x);
+  }
+  ASSERT_EQ(even, (std::vector<int>{4, 2, 6, 10}));
+  std::vector<int> scaled;
+  for (int x :
+       bst.range(3, 7) | std::views::transform([](int x) { return 10 * x; })) {
+    scaled.push_back(x);
+  }
+  ASSERT_EQ(scaled, (std::vector<int>{30, 40, 50, 60}));
+  ASSERT_TRUE(bst.range(7, 3).empty());
+  ASSERT_TRUE(bst.range(14, 20).empty());
+  std::vector<int> reversed;
+  for (int x : bst.view() | std::views::reverse | std::views::take(3)) {
+    reversed.push_back(x);
+  }
+  ASSERT_EQ(reversed, (std::vector<int>{13, 10, 7}));
+  ASSERT_EQ(*bst.rbegin(), 13);
+  ASSERT_EQ(*bst.rbegin<postorder_tag>(), 4);
+  std::vector<int> levels;
+  for (int x : bst.level_order()) {
+    levels.push_back(x);
+  }
+  ASSERT_EQ(levels, (std::vector<int>{4, 2, 6, 1, 3, 5, 10, 7, 13}));
+  ASSERT_EQ(std::ranges::count_if(bst.view<postorder_tag>(),
+                                  [](int x) { return x > 4; }),
+            5);
+
+  BinarySearchTree<int> empty;
+  ASSERT_TRUE(empty.view<preorder_tag>().empty());
+  auto levels_of_empty = empty.level_order();
+  ASSERT_TRUE(levels_of_empty.begin() == std::default_sentinel);
+  auto scan = empty.scan([](const int*, const int*) { return true; });
+  ASSERT_TRUE(scan.begin() == std::default_sentinel);
+}
+
+TEST(BstTestSuite, PrunedScanTest) {
+  std::vector<int> v(4095);
+  for (int i = 0; i < 4095; ++i) {
+    v[i] = i;
+  }
+  BinarySearchTree<int> bst;
+  bst.bulk_load(v.begin(), v.end());
+  size_t visited = 0;
+  auto overlaps = [&visited](const int* least, const int* greatest) {
+    ++visited;
+    return (greatest == nullptr || !(*greatest < 1000)) &&
+           (least == nullptr || *least < 1010);
+  };
+  std::vector<int> found;
+  for (int x : bst.scan(overlaps) | std::views::filter([](int x) {
+                 return 1000 <= x && x < 1010;
+               })) {
+    found.push_back(x);
+  }
+  ASSERT_EQ(found, (std::vector<int>{1000, 1001, 1002, 1003, 1004, 1005, 1006,
+                                     1007, 1008, 1009}));
+  ASSERT_LT(visited, 100);
+  std::vector<int> all;
+  for (int x : bst.scan([](const int*, const int*) { return true; })) {
+    all.push_back(x);
+  }
+  ASSERT_EQ(all, v);
+
+  std::vector<int> fives{5, 5, 5, 5, 5, 5, 5};
+  BinarySearchMultiTree<int> multi;
+  multi.bulk_load(fives.begin(), fives.end());
+  multi.insert(5);
+  multi.insert(1);
+  auto holds_five = [](const int* least, const int* greatest) {
+    return (least == nullptr || *least <= 5) &&
+           (greatest == nullptr || 5 <= *greatest);
+  };
+  size_t count = 0;
+  for (int x : multi.scan(holds_five)) {
+    count += x == 5 ? 1 : 0;
+  }
+  ASSERT_EQ(count, 8);
+}